@@ -0,0 +1,50 @@
+/**
+\ingroup	DeviceHexProtocol
+\file		HexCaptureDecode.cpp
+\brief		Command-line decoder for DeviceHexProtocol capture files
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+
+Usage:
+\code
+	HexCaptureDecode capture.hpcap [output.txt]
+\endcode
+
+Reads a binary capture written by DeviceHexProtocol::dumpCapture() and
+writes one human-readable transaction per line, prefixed by the time
+since the first record.
+*/
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+
+#include "../../include/ProtocolCapture.h"
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "usage: HexCaptureDecode capture.hpcap [output.txt]" << std::endl;
+		return 1;
+	}
+	std::ifstream in(argv[1], std::ios::in | std::ios::binary);
+	if (!in.is_open()) {
+		std::cerr << "could not open " << argv[1] << std::endl;
+		return 1;
+	}
+	std::ofstream out;
+	if (argc > 2) {
+		out.open(argv[2]);
+		if (!out.is_open()) {
+			std::cerr << "could not create " << argv[2] << std::endl;
+			return 1;
+		}
+	}
+	if (!hprot::decodeCapture(in, argc > 2 ? out : std::cout)) {
+		std::cerr << argv[1] << " is not a valid capture file" << std::endl;
+		return 1;
+	}
+	return 0;
+}
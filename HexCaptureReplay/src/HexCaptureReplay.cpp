@@ -0,0 +1,51 @@
+/**
+\ingroup	DeviceHexProtocol
+\file		HexCaptureReplay.cpp
+\brief		Command-line replay of DeviceHexProtocol capture files
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+
+Usage:
+\code
+	HexCaptureReplay capture.hpcap [baud [turnaround_us [timed]]]
+\endcode
+
+Replays a binary capture written by DeviceHexProtocol::dumpCapture()
+against an emulated slave and prints the wall time, per-command latency
+and round-trip counts. A baud rate of 0 disables wire-time simulation.
+Pass \c timed to reproduce the idle gaps recorded between transactions.
+*/
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+
+#include "../../include/ProtocolReplay.h"
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "usage: HexCaptureReplay capture.hpcap [baud [turnaround_us [timed]]]" << std::endl;
+		return 1;
+	}
+	std::ifstream in(argv[1], std::ios::in | std::ios::binary);
+	if (!in.is_open()) {
+		std::cerr << "could not open " << argv[1] << std::endl;
+		return 1;
+	}
+	hprot::ReplaySession session;
+	if (!session.loadCapture(in)) {
+		std::cerr << argv[1] << " is not a valid capture file" << std::endl;
+		return 1;
+	}
+	hprot::EmulatedSlave slave(session);
+	slave.withBaud(argc > 2 ? atol(argv[2]) : 0)
+		.withTurnaroundUs(argc > 3 ? atol(argv[3]) : 0);
+
+	hprot::ReplayEngine engine;
+	engine.withRecordedTiming(argc > 4 && strcmp(argv[4], "timed") == 0);
+	engine.replay(session, slave).print(std::cout);
+	return 0;
+}
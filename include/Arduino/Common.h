@@ -132,5 +132,6 @@ $Date: 2016-01-19 14:29:28 -0600 (Tue, 19 Jan 2016) $
 #pragma once
 
 #include "StringStream.h"
+#include "RingStream.h"
 #include "DebugPrint.h"
 
@@ -0,0 +1,221 @@
+/**
+\ingroup	ArduinoCommon
+\file		RingStream.h
+\brief		Defines a fixed-capacity Stream class backed by a ring buffer
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+
+*/
+
+#pragma once
+
+#ifndef __AVR__
+#error "This libary is only available for the Arduino"
+#endif
+
+#include <WString.h>
+#include <Stream.h>
+#include <stdio.h> // for size_t
+#if defined(TEST_RINGSTREAM) || defined(__INTELLISENSE__)
+#include <HardwareSerial.h>
+#endif
+
+
+/**
+A custom Arduino Stream backed by a fixed-size ring buffer.
+\ingroup	ArduinoCommon
+
+RingStream has the same interface as StringStream, but its capacity is
+fixed at compile time. It never touches the heap, and every read and
+write is O(1). Use it in place of StringStream as a loopback or log
+buffer on boards with little RAM.
+
+Writes to a full RingStream are dropped, and write() reports how many
+bytes were actually stored. str() is the only method that allocates.
+
+Being a template, RingStream is header-only and has no INSTANTIATE macro.
+
+@tparam N	capacity in bytes. Must be a power of two.
+*/
+template <size_t N>
+class RingStream : public Stream {
+	static_assert(N > 1 && (N & (N - 1)) == 0, "RingStream size must be a power of two");
+public:
+
+	/////////////////////////////////////////////////////////////////////////
+	/// \name constructors and destructors
+	///
+	///@{
+
+	/** Default constructor. Creates an empty buffer. */
+	RingStream() : head_(0), tail_(0) {}
+
+	/** Create a buffer holding a copy of a string. */
+	RingStream(const String& __val) : head_(0), tail_(0) {
+		write(reinterpret_cast<const uint8_t*>(__val.c_str()), __val.length());
+	}
+
+	/** Create a buffer holding a copy of a string in FLASH memory. */
+	RingStream(const __FlashStringHelper* __val) : head_(0), tail_(0) {
+		print(__val);
+	}
+
+	///@}
+	/////////////////////////////////////////////////////////////////////////
+
+	/////////////////////////////////////////////////////////////////////////
+	/// \name Print implementation
+	///
+	///@{
+	size_t write(uint8_t __c) override {
+		if (tail_ - head_ >= N) {
+			return 0;
+		}
+		buffer_[tail_++ & (N - 1)] = static_cast<char>(__c);
+		return 1;
+	}
+
+	size_t write(const uint8_t* __buffer, size_t __size) override {
+		size_t room = N - (tail_ - head_);
+		size_t count = __size < room ? __size : room;
+		for (size_t i = 0; i < count; i++) {
+			buffer_[tail_++ & (N - 1)] = static_cast<char>(__buffer[i]);
+		}
+		return count;
+	}
+
+	/** Free space in the buffer. */
+	int availableForWrite() {
+		return static_cast<int>(N - (tail_ - head_));
+	}
+
+	///@}
+	/////////////////////////////////////////////////////////////////////////
+
+	/////////////////////////////////////////////////////////////////////////
+	/// \name Stream implementation
+	///
+	///@{
+	int available() override {
+		return static_cast<int>(tail_ - head_);
+	}
+
+	int read() override {
+		if (head_ != tail_) {
+			return static_cast<int>(static_cast<uint8_t>(buffer_[head_++ & (N - 1)]));
+		}
+		return -1;
+	}
+
+	int peek() override {
+		if (head_ != tail_) {
+			return static_cast<int>(static_cast<uint8_t>(buffer_[head_ & (N - 1)]));
+		}
+		return -1;
+	}
+
+	/** Flush (clear) the buffer. */
+	void flush() override {
+		head_ = tail_ = 0;
+	}
+
+	///@}
+	/////////////////////////////////////////////////////////////////////////
+
+	/////////////////////////////////////////////////////////////////////////
+	/// \name unique RingStream methods
+	///
+	///@{
+
+	/** Get a copy of the unread bytes as a String object. */
+	virtual String str() const {
+		String res;
+		res.reserve(tail_ - head_);
+		for (size_t i = head_; i != tail_; i++) {
+			res += buffer_[i & (N - 1)];
+		}
+		return res;
+	}
+
+	/** Fixed capacity of the buffer. */
+	static size_t capacity() {
+		return N;
+	}
+
+	///@}
+	/////////////////////////////////////////////////////////////////////////
+
+	void debugPrint(Print& __printer) {
+		size_t i;
+		for (i = 0; i < N - (tail_ - head_); i++) {
+			__printer.write('.');
+		}
+		for (i = head_; i != tail_; i++) {
+			__printer.write(buffer_[i & (N - 1)]);
+		}
+	}
+
+protected:
+	/** The buffer. Indexed by the free-running head_ and tail_ counters modulo N. */
+	char buffer_[N];
+
+	/** Count of bytes read. Index of the next read or peek operation. */
+	size_t head_;
+
+	/** Count of bytes written. Index of the next write operation. */
+	size_t tail_;
+};
+
+//////////////////////////////////////////////////////////
+/// Test Code
+//////////////////////////////////////////////////////////
+#if defined(TEST_RINGSTREAM) || defined(__INTELLISENSE__)
+#include <Arduino.h>
+
+RingStream<64> ringstr;
+
+extern "C" {
+	void setup() {
+		Serial.begin(115200);
+		delay(1000);
+		ringstr.print("Hello World! ");
+		ringstr.print(123);
+		ringstr.print(" The cow jumped over ");
+		ringstr.print(3.1415);
+		Serial.println(ringstr.str());
+		Serial.println();
+
+		// keep writing as we read. The buffer never grows or moves
+		for (int n = 0; n < 200 && ringstr.available() > 0; n++) {
+			int i = ringstr.read();
+			Serial.write(i);
+			Serial.write(' ');
+			ringstr.debugPrint(Serial);
+			Serial.println();
+			ringstr.write(static_cast<uint8_t>(i));
+		}
+
+		Serial.println();
+		ringstr.flush();
+		ringstr.print("Line 1\nLine 2\nLine 3\n");
+		while (ringstr.available() > 0) {
+			String line = ringstr.readStringUntil('\n');
+			Serial.print("Got Line: ");
+			Serial.println(line);
+		}
+		Serial.println();
+		ringstr.print("1.23 120 150\n");
+		Serial.print("Got float: ");
+		Serial.println(ringstr.parseFloat());
+		Serial.print("Got int: ");
+		Serial.println(ringstr.parseInt());
+		Serial.print("Got int: ");
+		Serial.println(ringstr.parseInt());
+	}
+
+	void loop() {
+	}
+
+};
+#endif // TEST_RINGSTREAM
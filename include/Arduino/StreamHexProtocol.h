@@ -40,6 +40,16 @@ class MyHandler : public StreamHexProtocol<MyHandler> {
 		return true;
 	}
 
+	// optional: let the host raise the baud rate after detection
+	prot_ulong_t maxBaudRate() PROT_IO_OVERRIDE {
+		return 1000000;
+	}
+
+	void changeBaudRate(prot_ulong_t __baud) PROT_IO_OVERRIDE {
+		Serial.end();
+		Serial.begin(__baud);
+	}
+
 protected:
 	uint16_t value;
 };
@@ -52,6 +62,8 @@ void setup()
 	Serial.begin(BAUDRATE);
 	Serial.setTimeout(TIMEOUT);
     handler.startProtocol(&handler, &Serial);
+    // tell the host we are done booting
+    handler.announceReady();
 }
 
 void loop()
@@ -62,6 +74,66 @@ void loop()
 }
 \endcode
 
+Transmit buffering
+-----------------------------
+
+Replies are not written to the stream token by token. They are staged in a
+PROT_TX_BUFF_SIZE buffer and handed to the stream in one write when the
+command is done, so a native-USB board sends one packet per reply instead
+of one per token. processCommand() and pollCommand() flush the buffer
+themselves. A sketch that replies from anywhere else, such as an
+unsolicited message from loop(), must call flushReply() afterwards.
+
+Receiving strings
+-----------------------------
+
+Strings are never grown one character at a time. Set-string handlers that
+supply their own buffer, and the ReceiveStringFn handlers that borrow the
+shared PROT_STRING_BUFF_SIZE receive buffer, do not touch the heap at all.
+A string that does not fit is read to its end and refused with an error,
+so the protocol stays in step.
+
+\code{.cpp}
+	case SET_NAME:
+		processSetString(__cmd, &MyHandler::doSetName);
+		break;
+
+	bool doSetName(const char* __str, size_t __len) {
+		strncpy(name, __str, sizeof(name));
+		return true;
+	}
+\endcode
+
+processSet<prot_string_t>() still builds an Arduino String, but reads it
+through the same buffer, so the String grows a buffer at a time.
+
+Non-blocking command parsing
+-----------------------------
+
+hasCommand() and processCommand() block inside getValue() until each
+argument's [EOT] arrives, so loop() stalls for as long as the host takes
+to send the command. pollCommand() never waits. It moves whatever bytes
+have arrived into a frame buffer and runs the command function on the
+buffer. If an argument is still incomplete, the attempt is silently
+abandoned and repeated once more bytes arrive. Only a complete command
+reaches the DEV handler, so loop() jitter is bounded by the handler's own
+cost rather than by wire time.
+
+\code{.cpp}
+void loop()
+{
+	handler.pollCommand(&CHandler::doProcessCommand);
+	doTimingCriticalWork();
+}
+\endcode
+
+The processXXX functions already read every argument before they act or
+reply, which is what makes an abandoned attempt harmless. Custom handlers
+must do the same. A frame that fills PROT_FRAME_BUFF_SIZE, such as a long
+string argument, is finished with ordinary blocking reads, and a frame that
+stays incomplete for PROT_FRAME_TIMEOUT_MS fails just like a blocking read
+that timed out.
+
 */
 
 /**
@@ -98,6 +170,30 @@ $Date: 2016-01-29 16:57:23 -0600 (Fri, 29 Jan 2016) $
 #define END_SNDRCV_PIN
 #endif
 
+/** \ingroup StreamHexProtocol
+	Size of the pollCommand() frame buffer. Longer frames are finished with blocking reads. */
+#ifndef PROT_FRAME_BUFF_SIZE
+#define PROT_FRAME_BUFF_SIZE	64
+#endif
+
+/** \ingroup StreamHexProtocol
+	A partial pollCommand() frame older than this (in ms) is processed as if its reads timed out. */
+#ifndef PROT_FRAME_TIMEOUT_MS
+#define PROT_FRAME_TIMEOUT_MS	1000
+#endif
+
+/** \ingroup StreamHexProtocol
+	Size of the transmit staging buffer. Longer replies are sent in pieces of this size. */
+#ifndef PROT_TX_BUFF_SIZE
+#define PROT_TX_BUFF_SIZE		64
+#endif
+
+/** \ingroup StreamHexProtocol
+	Size of the shared string receive buffer, including the null terminator. */
+#ifndef PROT_STRING_BUFF_SIZE
+#define PROT_STRING_BUFF_SIZE	64
+#endif
+
 namespace hprot {
 
 	/** \ingroup StreamHexProtocol 
@@ -109,80 +205,173 @@ namespace hprot {
 		Implements HexProtocolBase on the Arduino side.
 		\ingroup StreamHexProtocol
 	*/
-	template <class DEV>
-	class StreamHexProtocol : public HexProtocolBase<DEV, STREAM_T> {
+	template <class DEV, class CODEC = PROT_CODEC>
+	class StreamHexProtocol : public HexProtocolBase<DEV, STREAM_T, CODEC> {
 	public:
 
 		StreamHexProtocol() {
 			SETUP_SNDRCV_PIN;
 		}
 
-		virtual ~StreamHexProtocol() {}
+		PROT_IO_VIRTUAL ~StreamHexProtocol() {}
 
 	protected:
-		typedef HexProtocolBase<DEV, STREAM_T> BaseClass;
+		typedef HexProtocolBase<DEV, STREAM_T, CODEC> BaseClass;
+		friend BaseClass;	// for PROT_STATIC_DISPATCH
+
+#ifdef PROT_STATIC_DISPATCH
+		/** The object that implements the slave hooks, resolved at compile time. */
+		DEV& slave() {
+			return *static_cast<DEV*>(this);
+		}
+#else
+		/** The object that implements the slave hooks, through the vtable. */
+		StreamHexProtocol& slave() {
+			return *this;
+		}
+#endif // PROT_STATIC_DISPATCH
 
 		/////////////////////////////////////////////////////////////////////////
 		/// \name HexProtocolBase Implementation
 		///
 		///@{
 
-		/** Write a single byte to the output stream. */
-		bool writeByte(prot_byte_t b) override {
-			if (!BaseClass::hasStarted()) {
+		/** Stage a single byte for the output stream. */
+		bool writeByte(prot_byte_t b) PROT_IO_OVERRIDE {
+			if (!BaseClass::hasStarted() || frameShort_) {
 				return false;
 			}
-			BEGIN_SNDRCV_PIN;
-			size_t nbytes = BaseClass::stream_->write(static_cast<uint8_t>(b));
-			END_SNDRCV_PIN;
-			return (nbytes == 1);
+			if (txLen_ == PROT_TX_BUFF_SIZE && !flushReply()) {
+				return false;
+			}
+			tx_[txLen_++] = static_cast<char>(b);
+			return true;
 		}
 
-		/** Write several bytes to the output stream. The term character should
+		/** Stage several bytes for the output stream. The term character should
 		be included in the buffer, or you can use a single writeByte()
 		to write the term character. */
-		size_t writeBuffer(const char* buffer, size_t size) override {
-			if (!BaseClass::hasStarted()) {
+		size_t writeBuffer(const char* buffer, size_t size) PROT_IO_OVERRIDE {
+			if (!BaseClass::hasStarted() || frameShort_) {
 				return 0;
 			}
-			BEGIN_SNDRCV_PIN;
-			size_t nbytes = BaseClass::stream_->write(buffer, size);
-			END_SNDRCV_PIN;
+			size_t nbytes = 0;
+			while (nbytes < size) {
+				if (txLen_ == PROT_TX_BUFF_SIZE && !flushReply()) {
+					break;
+				}
+				size_t room = PROT_TX_BUFF_SIZE - txLen_;
+				size_t chunk = (size - nbytes < room) ? size - nbytes : room;
+				memcpy(tx_ + txLen_, buffer + nbytes, chunk);
+				txLen_ += chunk;
+				nbytes += chunk;
+			}
 			return nbytes;
 		}
 
 		/** Read a string of bytes from the stream **UNTIL** a terminator character is received, or a
 		timeout occurrs. The terminator character is NOT added to the end of the buffer. */
-		size_t readBufferUntilTerminator(char* buffer, size_t size, char terminator) override {
+		size_t readBufferUntilTerminator(char* buffer, size_t size, char terminator) PROT_IO_OVERRIDE {
 			if (!BaseClass::hasStarted()) {
 				return 0;
 			}
-			// NOTE: readBytesUntil does not store the terminator character
-			BEGIN_SNDRCV_PIN;
-			size_t nbytes = BaseClass::stream_->readBytesUntil(terminator, buffer, size);
-			END_SNDRCV_PIN;
-			return nbytes;
+			size_t nbytes = 0;
+			if (!framing_ || !readFrame(buffer, size, terminator, nbytes)) {
+				if (framing_ && !frameFinal_) {
+					frameShort_ = true;
+					return 0;
+				}
+				// NOTE: readBytesUntil does not store the terminator character
+				BEGIN_SNDRCV_PIN;
+				nbytes += BaseClass::stream_->readBytesUntil(terminator, buffer + nbytes, size - nbytes);
+				END_SNDRCV_PIN;
+			}
+			return BaseClass::noteSync(buffer, nbytes, nbytes < size) ? 0 : nbytes;
 		}
 
 		/** Reads a string of arbitrary length from the stream **UNTIL** a terminator character is
 		received, or a timeout occurrs. The terminator character is NOT added to the end
-		of the string, but the string is null terminated.
-		\note On the Arduino, readStringUnreadStringUntilTerminatortil is much slower than
-		readBufferUntilTerminator because each additional character might trigger a reallocation
-		to increase the string buffer size. readStringUntilTerminator is primarily used for
-		getValue<prot_string_t>(). */
-		size_t readStringUntilTerminator(prot_string_t& str, char terminator) override {
+		of the string. readStringUntilTerminator is primarily used for getValue<prot_string_t>().
+		\note The string is read through the PROT_STRING_BUFF_SIZE receive buffer, so it
+		grows a buffer at a time rather than a character at a time. Handlers that must not 
+		touch the heap at all should use processSetString() with a ReceiveStringFn. */
+		size_t readStringUntilTerminator(prot_string_t& str, char terminator) PROT_IO_OVERRIDE {
 			if (!BaseClass::hasStarted()) {
 				return 0;
 			}
-			// NOTE: readBytesUntil does not store the terminator character
+			str = "";
+			size_t nbytes;
+			do {
+				nbytes = readBufferUntilTerminator(rxString_, PROT_STRING_BUFF_SIZE - 1, terminator);
+				if (frameShort_ || BaseClass::syncPending_) {
+					return 0;
+				}
+				rxString_[nbytes] = '\0';
+				str += rxString_;
+			} while (nbytes == PROT_STRING_BUFF_SIZE - 1);
+			return str.length();
+		}
+
+		/** Reads a string into a caller-supplied buffer without using the heap. A string
+		that does not fit in __size - 1 characters is read to its end and discarded.
+		@return length of the string, or 0 if nothing was read or the string was too long */
+		size_t readStringBufferUntilTerminator(char* buffer, size_t size, char terminator) PROT_IO_OVERRIDE {
+			if (size == 0) {
+				return 0;
+			}
+			size_t nbytes = readBufferUntilTerminator(buffer, size - 1, terminator);
+			buffer[nbytes] = '\0';
+			if (frameShort_ || BaseClass::syncPending_) {
+				return 0;
+			}
+			if (nbytes < size - 1) {
+				return nbytes;
+			}
+			// the buffer is full. Either the terminator is next or the string is too long
+			char c;
+			if (readBufferUntilTerminator(&c, 1, terminator) == 0) {
+				return (frameShort_ || BaseClass::syncPending_) ? 0 : nbytes;
+			}
+			while (readBufferUntilTerminator(rxString_, PROT_STRING_BUFF_SIZE, terminator) == PROT_STRING_BUFF_SIZE) {
+				// skip the rest of the string
+			}
+			buffer[0] = '\0';
+			return 0;
+		}
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Transmit buffering
+		///
+		///@{
+	public:
+		/** Hand the staged reply to the stream in a single write. processCommand()
+		and pollCommand() call this after every command. Call it yourself after
+		sending a reply from outside a command function.
+		@return false if the stream did not take every byte */
+		bool flushReply() PROT_IO_OVERRIDE {
+			if (frameShort_) {
+				// the attempt was abandoned. Nothing it staged may leave
+				txLen_ = 0;
+				return false;
+			}
+			if (txLen_ == 0) {
+				return true;
+			}
 			BEGIN_SNDRCV_PIN;
-			str = BaseClass::stream_->readStringUntil(terminator);
-			size_t len = str.length();
+			size_t nbytes = BaseClass::stream_->write(tx_, txLen_);
 			END_SNDRCV_PIN;
-			return len;
+			bool ok = (nbytes == txLen_);
+			txLen_ = 0;
+			return ok;
 		}
 
+	protected:
+		char tx_[PROT_TX_BUFF_SIZE];		///< reply being assembled
+		size_t txLen_ = 0;					///< bytes in tx_
+
 		///@}
 		/////////////////////////////////////////////////////////////////////////
 
@@ -193,19 +382,29 @@ namespace hprot {
 		///
 		///@{
 
-		/** Check to see if the input stream has a byte to read. */
-		bool hasByte() override {
+		/** Check to see if the input stream has a byte to read. Also reverts an
+		unconfirmed baud rate change once PROT_BAUD_VERIFY_MS has passed. */
+		bool hasByte() PROT_IO_OVERRIDE {
 			if (!BaseClass::hasStarted()) {
 				return false;
 			}
+			if (revertBaud_ && static_cast<long>(millis() - revertAt_) >= 0) {
+				slave().changeBaudRate(revertBaud_);
+				baud_ = revertBaud_;
+				revertBaud_ = 0;
+			}
 			return (BaseClass::stream_->available() > 0);
 		}
 
 		/** Read a single byte from the input stream. */
-		bool readByte(prot_byte_t& b) override {
+		bool readByte(prot_byte_t& b) PROT_IO_OVERRIDE {
 			if (!BaseClass::hasStarted()) {
 				return false;
 			}
+			if (framing_ && framePos_ < frameLen_) {
+				b = static_cast<prot_byte_t>(frame_[framePos_++]);
+				return true;
+			}
 			BEGIN_SNDRCV_PIN;
 			int i = BaseClass::stream_->read();
 			END_SNDRCV_PIN;
@@ -219,27 +418,273 @@ namespace hprot {
 		///@}
 		/////////////////////////////////////////////////////////////////////////
 
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Non-blocking command parsing
+		///
+		///@{
+	public:
+		/** Move any waiting bytes into the frame buffer and process the frame once
+		it holds a complete command. Never waits for the stream. Call it on every
+		loop() instead of hasCommand() and processCommand().
+		@return true if a command was processed */
+		bool pollCommand(typename BaseClass::CommandFn::type __processFn) {
+			return pollFrame(__processFn, nullptr, 0);
+		}
+
+		/** pollCommand() with a command table instead of a CommandFn.
+		@see HexProtocolBase::processCommand() */
+		bool pollCommand(const typename BaseClass::CommandEntry* __table, size_t __count) {
+			return pollFrame(nullptr, __table, __count);
+		}
+
+		/** pollCommand() with a command table array. */
+		template <size_t N>
+		bool pollCommand(const typename BaseClass::CommandEntry (&__table)[N]) {
+			return pollFrame(nullptr, __table, N);
+		}
+
+	protected:
+		/** Common part of the pollCommand() functions. Processes the frame with
+		__table if it is given, otherwise with __processFn. */
+		bool pollFrame(typename BaseClass::CommandFn::type __processFn, const typename BaseClass::CommandEntry* __table, size_t __count) {
+			if (!hasByte() && frameLen_ == 0) {
+				return false;
+			}
+			size_t before = frameLen_;
+			BEGIN_SNDRCV_PIN;
+			while (frameLen_ < PROT_FRAME_BUFF_SIZE && BaseClass::stream_->available() > 0) {
+				int i = BaseClass::stream_->read();
+				if (i == -1) {
+					break;
+				}
+				frame_[frameLen_++] = static_cast<char>(i);
+			}
+			END_SNDRCV_PIN;
+			if (before == 0 && frameLen_ > 0) {
+				frameStart_ = millis();
+			}
+			bool full = (frameLen_ == PROT_FRAME_BUFF_SIZE);
+			bool stale = static_cast<unsigned long>(millis() - frameStart_) >= PROT_FRAME_TIMEOUT_MS;
+			if (frameLen_ == 0 || (frameWaiting_ && frameLen_ == before && !full && !stale)) {
+				// nothing new since the last abandoned attempt
+				return false;
+			}
+			framing_ = true;
+			frameFinal_ = full || stale;
+			frameShort_ = false;
+			framePos_ = 1;
+			if (__table) {
+				BaseClass::processCommand(static_cast<prot_cmd_t>(frame_[0]), __table, __count);
+			} else {
+				BaseClass::processCommand(static_cast<prot_cmd_t>(frame_[0]), __processFn);
+			}
+			framing_ = false;
+			frameWaiting_ = frameShort_;
+			if (frameShort_) {
+				// an argument is still on the wire. Try again when more arrives
+				frameShort_ = false;
+				return false;
+			}
+			// keep the start of the next command
+			size_t used = framePos_ < frameLen_ ? framePos_ : frameLen_;
+			memmove(frame_, frame_ + used, frameLen_ - used);
+			frameLen_ -= used;
+			frameStart_ = millis();
+			return true;
+		}
+
+		/** Copy the next token from the frame buffer, like readBytesUntil() does from the stream.
+		@param[out] __nbytes characters copied to __buffer
+		@return true if the token ended inside the frame or filled __buffer */
+		bool readFrame(char* __buffer, size_t __size, char __terminator, size_t& __nbytes) {
+			__nbytes = 0;
+			while (framePos_ < frameLen_ && __nbytes < __size) {
+				char c = frame_[framePos_++];
+				if (c == __terminator) {
+					return true;
+				}
+				__buffer[__nbytes++] = c;
+			}
+			return (__nbytes == __size);
+		}
+
+		char frame_[PROT_FRAME_BUFF_SIZE];	///< bytes of the command being assembled
+		size_t frameLen_ = 0;				///< bytes in frame_
+		size_t framePos_ = 0;				///< next byte of frame_ to read
+		unsigned long frameStart_ = 0;		///< millis() when the frame started
+		bool framing_ = false;				///< reads come from frame_
+		bool frameFinal_ = false;			///< finish reads from the stream instead of abandoning the attempt
+		bool frameShort_ = false;			///< a read ran out of frame, so writes are dropped
+		bool frameWaiting_ = false;			///< the last attempt was abandoned. Wait for more bytes
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name System commands
+		///
+		///@{
+
+		/** Highest baud rate the slave accepts for PROT_SYS_BAUD. The default of 0 
+		refuses every baud rate change. Override together with changeBaudRate(). */
+		PROT_IO_VIRTUAL prot_ulong_t maxBaudRate() {
+			return 0;
+		}
+
+		/** Switch the serial port to __baud. Override to restart the port, e.g.
+		\code{.cpp}
+			void changeBaudRate(prot_ulong_t __baud) PROT_IO_OVERRIDE {
+				Serial.end();
+				Serial.begin(__baud);
+			}
+		\endcode */
+		PROT_IO_VIRTUAL void changeBaudRate(prot_ulong_t __baud) { }
+
+		/** Adds the baud rate family and the serial receive buffer size. */
+		ProtocolCaps localCaps() PROT_IO_OVERRIDE {
+			ProtocolCaps caps = BaseClass::localCaps();
+			caps.families |= CAP_FAM_SYNC | CAP_FAM_HEARTBEAT;
+			if (slave().maxBaudRate() > 0) {
+				caps.families |= CAP_FAM_BAUD;
+			}
+#ifdef SERIAL_RX_BUFFER_SIZE
+			caps.rxBufferSize = SERIAL_RX_BUFFER_SIZE;
+#else
+			caps.rxBufferSize = 64;
+#endif
+			return caps;
+		}
+
+		/** Handles PROT_SYS_BAUD and PROT_SYS_HEARTBEAT, and confirms baud rate 
+		changes on PROT_SYS_PING. */
+		bool processSystemCommand(prot_cmd_t __cmd) PROT_IO_OVERRIDE {
+			switch (__cmd) {
+			case PROT_SYS_PING:
+				// the host reached us at the new baud rate
+				revertBaud_ = 0;
+				break;
+			case PROT_SYS_BAUD:
+				processBaudRate();
+				return true;
+			case PROT_SYS_HEARTBEAT:
+				// millis() restarts at 0 on a reset, which is how the host notices
+				test(BaseClass::reply(__cmd) && BaseClass::template putValue<prot_ulong_t>(millis()));
+				return true;
+			}
+			return BaseClass::processSystemCommand(__cmd);
+		}
+
+		/** Process BAUD(newBaud, oldBaud). The reply is sent at the old baud rate.
+		newBaud must be faster than oldBaud and no faster than maxBaudRate(). oldBaud
+		is where the slave reverts to, so once a change has been made it must be the
+		baud rate in use. A second change is refused until the first is confirmed. */
+		bool processBaudRate() {
+			prot_ulong_t newBaud, oldBaud;
+			if (!test(BaseClass::template getValue<prot_ulong_t>(newBaud) && BaseClass::template getValue<prot_ulong_t>(oldBaud) 
+					&& oldBaud > 0 && newBaud > oldBaud && newBaud <= slave().maxBaudRate()
+					&& (baud_ == 0 || oldBaud == baud_) && revertBaud_ == 0)) {
+				return BaseClass::replyError();
+			}
+			if (!test(BaseClass::reply(PROT_SYS_BAUD) && flushReply())) {
+				return false;
+			}
+			// wait for the reply to leave before switching
+			BaseClass::stream_->flush();
+			slave().changeBaudRate(newBaud);
+			baud_ = newBaud;
+			revertBaud_ = oldBaud;
+			revertAt_ = millis() + PROT_BAUD_VERIFY_MS;
+			return true;
+		}
+
+		prot_ulong_t baud_ = 0;			///< baud rate set by PROT_SYS_BAUD, or 0 for the power-on rate
+		prot_ulong_t revertBaud_ = 0;		///< baud rate to revert to if no PING arrives, or 0
+		unsigned long revertAt_ = 0;		///< millis() at which to revert
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Receiving strings without the heap
+		///
+		///@{
+	public:
+		using BaseClass::processSetString;
+		using BaseClass::processChannelSetString;
+
+		/** Member function that receives a string in the shared receive buffer.
+		The string is only valid during the call, so copy what must be kept.
+
+		@param[in] __str the null terminated string
+		@param[in] __len length of the string
+		@return Must return true if successful
+		*/
+		struct ReceiveStringFn {
+			typedef bool (DEV::*type)(const char* __str, size_t __len);
+		};
+
+		/** Process a set-string command for a handler without a buffer of its own. The 
+		string is received in the PROT_STRING_BUFF_SIZE buffer. Calls a ReceiveStringFn. */
+		bool processSetString(prot_cmd_t __cmdSet, typename ReceiveStringFn::type __strFn) {
+			size_t len = readStringBufferUntilTerminator(rxString_, PROT_STRING_BUFF_SIZE, PROT_TERM_CHAR);
+			if (test(len > 0 && BaseClass::target_ && (BaseClass::target_ ->* __strFn)(rxString_, len))) {
+				return BaseClass::reply(__cmdSet);
+			}
+			return BaseClass::replyError();
+		}
+
+		/** Member function that receives a string on a specific channel in the shared receive buffer.
+		@see ReceiveStringFn
+		*/
+		struct ChannelReceiveStringFn {
+			typedef bool (DEV::*type)(prot_chan_t __chan, const char* __str, size_t __len);
+		};
+
+		/** Process a set-string command on a specific channel for a handler without a buffer
+		of its own. Calls a ChannelReceiveStringFn. */
+		bool processChannelSetString(prot_cmd_t __cmdSet, typename ChannelReceiveStringFn::type __strFn) {
+			prot_chan_t chan;
+			if (!BaseClass::template getValue<prot_chan_t>(chan)) {
+				return BaseClass::replyError();
+			}
+			size_t len = readStringBufferUntilTerminator(rxString_, PROT_STRING_BUFF_SIZE, PROT_TERM_CHAR);
+			if (test(len > 0 && BaseClass::target_ && (BaseClass::target_ ->* __strFn)(chan, rxString_, len))) {
+				return BaseClass::reply(__cmdSet);
+			}
+			return BaseClass::replyError();
+		}
+
+	protected:
+		char rxString_[PROT_STRING_BUFF_SIZE];	///< shared string receive buffer
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
 		/////////////////////////////////////////////////////////////////////////
 		/// \name Sending strings from flash memory, Low-level
 		///
 		///@{
 
 #ifdef PROGMEM
-		/** Send a string from program space. */
+		/** Send a string from program space. The string is copied into the
+		transmit buffer in chunks rather than read one byte at a time. */
 		bool putString_P(PGM_P __str_P) {
+			if (!BaseClass::hasStarted() || frameShort_) {
+				return false;
+			}
 			size_t len = strlen_P(__str_P);
 			size_t bytesWritten = 0;
-			prot_byte_t ch;
-			while (ch =  pgm_read_byte(__str_P++)) {
-				if (!writeByte(ch)) {
-					break;
+			while (bytesWritten < len) {
+				if (txLen_ == PROT_TX_BUFF_SIZE && !flushReply()) {
+					return false;
 				}
-				bytesWritten++;
-			}
-			if (writeByte(PROT_TERM_CHAR)) {
-				bytesWritten++;
+				size_t room = PROT_TX_BUFF_SIZE - txLen_;
+				size_t chunk = (len - bytesWritten < room) ? len - bytesWritten : room;
+				memcpy_P(tx_ + txLen_, __str_P + bytesWritten, chunk);
+				txLen_ += chunk;
+				bytesWritten += chunk;
 			}
-			return (bytesWritten == len + 1);
+			return writeByte(PROT_TERM_CHAR);
 		}
 
 		/** Simple processGetString_P that does not use a delegate. */
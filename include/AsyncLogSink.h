@@ -0,0 +1,228 @@
+/**
+\ingroup	DeviceHexProtocol
+\file		AsyncLogSink.h
+\brief		Lock-free queue and background thread for protocol logging
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+/**
+\ingroup DeviceHexProtocol
+
+\page AboutAsyncLogSink About the Asynchronous Log Sink
+
+About the Asynchronous Log Sink
+==========================
+
+The Micro-Manager core logger formats and locks on every LogMessage call.
+Calling it from the I/O path adds that cost to every transaction.
+AsyncLogSink moves it to a background thread.
+
+- Producers push raw CaptureRecord structures into a bounded lock-free
+  multiple-producer, single-consumer queue. A push is one atomic
+  compare-and-swap and a 32 byte copy. It never blocks and never allocates.
+- The drain thread pops the records, groups them into transactions and
+  renders each one with renderTransaction(). All formatting happens here.
+- Each rendered transaction is passed to a forwarding function, normally
+  LogMessage on the device.
+
+If the queue is full the record is dropped and counted. The partial
+transaction is discarded on the drain side, and a single line reporting the
+number of dropped records is logged once the queue catches up.
+
+DeviceHexProtocol::startAsyncLog() and stopAsyncLog() manage the sink for a
+device.
+*/
+
+#pragma once
+
+#include "ProtocolCapture.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hprot {
+
+	/** Longest time (ms) a queued record waits before the drain thread looks for it.
+	\ingroup DeviceHexProtocol */
+	const int PROT_ASYNC_LOG_POLL_MS = 20;
+
+	/**
+	Bounded lock-free multiple-producer, single-consumer queue with a
+	background drain thread.
+
+	\ingroup DeviceHexProtocol
+
+	The queue uses a sequence number per slot (after D. Vyukov's bounded
+	MPMC queue), so producers only contend on the tail index.
+
+	@tparam N	number of slots in the queue. Must be a power of two.
+	*/
+	template <size_t N>
+	class AsyncLogSink {
+		static_assert(N > 1 && (N & (N - 1)) == 0, "AsyncLogSink size must be a power of two");
+	public:
+		/** Receives each rendered transaction on the drain thread. */
+		typedef std::function<void(const std::string&)> ForwardFn;
+
+		AsyncLogSink() : head_(0), tail_(0), dropped_(0), running_(false) {
+			for (size_t i = 0; i < N; i++) {
+				slots_[i].seq.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		~AsyncLogSink() {
+			stop();
+		}
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Producer side
+		///
+		///@{
+
+		/** Queue a record for logging. Safe to call from any thread.
+		@return false if the queue was full and the record was dropped */
+		bool push(const CaptureRecord& __rec) {
+			size_t pos = tail_.load(std::memory_order_relaxed);
+			for (;;) {
+				Slot& slot = slots_[pos & (N - 1)];
+				size_t seq = slot.seq.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+				if (diff == 0) {
+					if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						slot.rec = __rec;
+						slot.seq.store(pos + 1, std::memory_order_release);
+						if (__rec.dir == CAPTURE_END) {
+							wake_.notify_one();
+						}
+						return true;
+					}
+				} else if (diff < 0) {
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				} else {
+					pos = tail_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/** Number of records dropped because the queue was full. */
+		std::uint64_t dropped() const {
+			return dropped_.load(std::memory_order_relaxed);
+		}
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Drain thread
+		///
+		///@{
+
+		/** Start the drain thread. Does nothing if it is already running. */
+		void start(ForwardFn __forward) {
+			if (running_.exchange(true)) {
+				return;
+			}
+			forward_ = __forward;
+			thread_ = std::thread(&AsyncLogSink::drainLoop, this);
+		}
+
+		/** Drain whatever is left in the queue and stop the thread. Records
+		pushed after the last pass are discarded, so a restarted sink does not
+		begin in the middle of a transaction. */
+		void stop() {
+			if (!running_.exchange(false)) {
+				return;
+			}
+			wake_.notify_one();
+			if (thread_.joinable()) {
+				thread_.join();
+			}
+			// the drain thread is gone, so this is the consumer now
+			CaptureRecord rec;
+			while (pop(rec)) { }
+			forward_ = ForwardFn();
+		}
+
+		/** True if the drain thread is running. */
+		bool running() const {
+			return running_.load(std::memory_order_relaxed);
+		}
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+	protected:
+		struct Slot {
+			std::atomic<size_t> seq;
+			CaptureRecord rec;
+		};
+
+		/** Consumer side of the queue. Only called from the drain thread. */
+		bool pop(CaptureRecord& __rec) {
+			Slot& slot = slots_[head_ & (N - 1)];
+			size_t seq = slot.seq.load(std::memory_order_acquire);
+			if (static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(head_ + 1) < 0) {
+				return false;
+			}
+			__rec = slot.rec;
+			slot.seq.store(head_ + N, std::memory_order_release);
+			head_++;
+			return true;
+		}
+
+		void drainLoop() {
+			std::vector<CaptureRecord> trans;
+			// drops from an earlier run were reported then
+			std::uint64_t reported = dropped();
+			bool more = true;
+			while (more) {
+				more = running();
+				CaptureRecord rec;
+				while (pop(rec)) {
+					std::uint8_t dir = rec.dir & ~CAPTURE_CONTINUED;
+					if (dir == CAPTURE_BEGIN) {
+						// a begin without an end means records were dropped
+						trans.clear();
+					}
+					trans.push_back(rec);
+					if (dir == CAPTURE_END) {
+						forward_(renderTransaction(trans));
+						trans.clear();
+					}
+				}
+				std::uint64_t drops = dropped();
+				if (drops != reported) {
+					std::ostringstream os;
+					os << "protocol log dropped " << (drops - reported) << " records";
+					forward_(os.str());
+					reported = drops;
+				}
+				if (more) {
+					std::unique_lock<std::mutex> lock(wakeMutex_);
+					wake_.wait_for(lock, std::chrono::milliseconds(PROT_ASYNC_LOG_POLL_MS));
+				}
+			}
+		}
+
+		Slot slots_[N];
+		size_t head_;							///< consumer index, drain thread only
+		std::atomic<size_t> tail_;				///< producer index
+		std::atomic<std::uint64_t> dropped_;	///< records dropped because the queue was full
+		std::atomic<bool> running_;
+		ForwardFn forward_;
+		std::thread thread_;
+		std::mutex wakeMutex_;
+		std::condition_variable wake_;
+	};
+
+}; // namespace hprot
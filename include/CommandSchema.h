@@ -0,0 +1,325 @@
+/**
+\ingroup	HexProtocol
+\file		CommandSchema.h
+\brief		Typed command descriptors shared by the host and the slave
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+/**
+\ingroup HexProtocol
+
+\page AboutCommandSchema About Command Schemas
+
+About Command Schemas
+==========================
+
+Without a schema, every command byte is written twice: once in the host's
+dprop::CommandSet and once in the slave's dispatch code. When they drift
+apart, the host gets an error reply or waits for a timeout, with nothing to
+say why. A command schema is a header, shared by the host and the slave
+firmware, that declares each command once, together with its kind and its
+value type.
+
+\code{.cpp}
+// MyCommands.h, included by both sides
+#include "CommandSchema.h"
+
+namespace mycmd {
+	typedef hprot::SetCommand<'v', uint16_t> SetValue;
+	typedef hprot::GetCommand<'V', uint16_t> GetValue;
+	typedef hprot::ChannelSetCommand<'l', uint8_t> SetLevel;
+	typedef hprot::TaskCommand<'r'> Reset;
+};
+\endcode
+
+The slave builds its command table from the schema with schemaEntry(). The
+handler's signature must match the descriptor exactly, or the table does not
+compile. The entries must be sorted by command byte.
+
+\code{.cpp}
+const MyHandler::CommandEntry MyHandler::commands[] PROGMEM = {
+	hprot::schemaEntry<MyHandler, mycmd::GetValue, &MyHandler::doGetValue>(),	// 'V'
+	hprot::schemaEntry<MyHandler, mycmd::SetLevel, &MyHandler::doSetLevel>(),	// 'l'
+	hprot::schemaEntry<MyHandler, mycmd::Reset, &MyHandler::doReset>(),			// 'r'
+	hprot::schemaEntry<MyHandler, mycmd::SetValue, &MyHandler::doSetValue>(),	// 'v'
+};
+\endcode
+
+The host builds its command sets from the same descriptors with
+dprop::TypedCommandSet. The descriptor's value type must match the
+property's type, and a channel set only takes channel descriptors, or the 
+command set does not compile.
+
+\code{.cpp}
+dprop::TypedCommandSet<uint16_t> cmds = dprop::TypedCommandSet<uint16_t>::build()
+	.withSet<mycmd::SetValue>().withGet<mycmd::GetValue>();
+valueProp_.createRemoteProp(this, hub, propInfo, cmds);
+
+dprop::TypedCommandSet<uint8_t, true> levelCmds = dprop::TypedCommandSet<uint8_t, true>::build(2)
+	.withSet<mycmd::SetLevel>();
+\endcode
+*/
+
+#pragma once
+
+#include "HexProtocol.h"
+
+namespace hprot {
+
+	/** How a command is unpacked on the slave. \ingroup HexProtocol */
+	enum CommandKind {
+		CMD_KIND_TASK,			///< processTask()
+		CMD_KIND_SET,			///< processSet()
+		CMD_KIND_GET,			///< processGet()
+		CMD_KIND_SET_STRING,	///< processSetString()
+		CMD_KIND_GET_STRING,	///< processGetString()
+		CMD_KIND_SET_ARRAY,		///< processSetArray()
+		CMD_KIND_GET_ARRAY		///< processGetArray()
+	};
+
+	/** Marks commands that do not carry a value. \ingroup HexProtocol */
+	struct NoValue { };
+
+	/**
+	Compile-time description of one command.
+
+	\ingroup HexProtocol
+
+	Use one of the aliases such as SetCommand or ChannelGetArrayCommand
+	rather than CommandDesc itself.
+
+	@tparam CMD		command byte
+	@tparam KIND	how the slave unpacks the command
+	@tparam T		value type, or element type for arrays
+	@tparam CHAN	true if a channel number precedes the value
+	*/
+	template <prot_cmd_t CMD, CommandKind KIND, typename T = NoValue, bool CHAN = false>
+	struct CommandDesc {
+		typedef T value_type;
+		static constexpr prot_cmd_t cmd = CMD;
+		static constexpr CommandKind kind = KIND;
+		static constexpr bool channel = CHAN;
+	};
+
+	template <prot_cmd_t CMD, CommandKind KIND, typename T, bool CHAN>
+	constexpr prot_cmd_t CommandDesc<CMD, KIND, T, CHAN>::cmd;
+
+	template <prot_cmd_t CMD, CommandKind KIND, typename T, bool CHAN>
+	constexpr CommandKind CommandDesc<CMD, KIND, T, CHAN>::kind;
+
+	template <prot_cmd_t CMD, CommandKind KIND, typename T, bool CHAN>
+	constexpr bool CommandDesc<CMD, KIND, T, CHAN>::channel;
+
+	/////////////////////////////////////////////////////////////////////////
+	/// \name Command descriptors
+	/// \ingroup HexProtocol
+	///
+	///@{
+
+	template <prot_cmd_t CMD>
+	using TaskCommand = CommandDesc<CMD, CMD_KIND_TASK>;
+
+	template <prot_cmd_t CMD>
+	using ChannelTaskCommand = CommandDesc<CMD, CMD_KIND_TASK, NoValue, true>;
+
+	template <prot_cmd_t CMD, typename T>
+	using SetCommand = CommandDesc<CMD, CMD_KIND_SET, T>;
+
+	template <prot_cmd_t CMD, typename T>
+	using ChannelSetCommand = CommandDesc<CMD, CMD_KIND_SET, T, true>;
+
+	template <prot_cmd_t CMD, typename T>
+	using GetCommand = CommandDesc<CMD, CMD_KIND_GET, T>;
+
+	template <prot_cmd_t CMD, typename T>
+	using ChannelGetCommand = CommandDesc<CMD, CMD_KIND_GET, T, true>;
+
+	template <prot_cmd_t CMD>
+	using SetStringCommand = CommandDesc<CMD, CMD_KIND_SET_STRING, prot_string_t>;
+
+	template <prot_cmd_t CMD>
+	using ChannelSetStringCommand = CommandDesc<CMD, CMD_KIND_SET_STRING, prot_string_t, true>;
+
+	template <prot_cmd_t CMD>
+	using GetStringCommand = CommandDesc<CMD, CMD_KIND_GET_STRING, prot_string_t>;
+
+	template <prot_cmd_t CMD>
+	using ChannelGetStringCommand = CommandDesc<CMD, CMD_KIND_GET_STRING, prot_string_t, true>;
+
+	template <prot_cmd_t CMD, typename T>
+	using SetArrayCommand = CommandDesc<CMD, CMD_KIND_SET_ARRAY, T>;
+
+	template <prot_cmd_t CMD, typename T>
+	using ChannelSetArrayCommand = CommandDesc<CMD, CMD_KIND_SET_ARRAY, T, true>;
+
+	template <prot_cmd_t CMD, typename T>
+	using GetArrayCommand = CommandDesc<CMD, CMD_KIND_GET_ARRAY, T>;
+
+	template <prot_cmd_t CMD, typename T>
+	using ChannelGetArrayCommand = CommandDesc<CMD, CMD_KIND_GET_ARRAY, T, true>;
+
+	///@}
+	/////////////////////////////////////////////////////////////////////////
+
+	/** Compile-time type equality. The Arduino has no \<type_traits\>. \ingroup HexProtocol */
+	template <typename A, typename B>
+	struct SchemaSameType {
+		static constexpr bool value = false;
+	};
+
+	template <typename A>
+	struct SchemaSameType<A, A> {
+		static constexpr bool value = true;
+	};
+
+	/////////////////////////////////////////////////////////////////////////
+	/// \name Slave handlers
+	/// SchemaHandler<DEV, D>::type is the member function a DEV must supply
+	/// for the descriptor D, and SchemaHandler<DEV, D>::call is the command
+	/// table thunk that unpacks it.
+	///
+	///@{
+
+	template <class DEV, class D, CommandKind KIND = D::kind, bool CHAN = D::channel>
+	struct SchemaHandler;
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_TASK, false> {
+		typedef bool (DEV::*type)(void);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processTask(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_TASK, true> {
+		typedef bool (DEV::*type)(prot_chan_t __chan);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processChannelTask(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_SET, false> {
+		typedef bool (DEV::*type)(const typename D::value_type __t);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processSet<typename D::value_type>(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_SET, true> {
+		typedef bool (DEV::*type)(prot_chan_t __chan, const typename D::value_type __t);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processChannelSet<typename D::value_type>(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_GET, false> {
+		typedef bool (DEV::*type)(typename D::value_type& __t);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processGet<typename D::value_type>(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_GET, true> {
+		typedef bool (DEV::*type)(prot_chan_t __chan, typename D::value_type& __t);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processChannelGet<typename D::value_type>(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_SET_STRING, false> {
+		typedef bool (DEV::*type)(char*& __strbuf, size_t& __maxSize, size_t __finalSize);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processSetString(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_SET_STRING, true> {
+		typedef bool (DEV::*type)(prot_chan_t __chan, char*& __strbuf, size_t& __maxSize, size_t __finalSize);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processChannelSetString(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_GET_STRING, false> {
+		typedef bool (DEV::*type)(const char*& __strbuf);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processGetString(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_GET_STRING, true> {
+		typedef bool (DEV::*type)(prot_chan_t __chan, const char*& __strbuf);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processChannelGetString(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_SET_ARRAY, false> {
+		typedef bool (DEV::*type)(typename D::value_type*& __pArr, size_t& __maxSize, size_t __finalSize);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processSetArray<typename D::value_type>(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_SET_ARRAY, true> {
+		typedef bool (DEV::*type)(prot_chan_t __chan, typename D::value_type*& __pArr, size_t& __maxSize, size_t __finalSize);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processChannelSetArray<typename D::value_type>(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_GET_ARRAY, false> {
+		typedef bool (DEV::*type)(bool __beforeGetFlag, typename D::value_type*& __pArr, prot_size_t& __size);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processGetArray<typename D::value_type>(__cmd, FN);
+		}
+	};
+
+	template <class DEV, class D>
+	struct SchemaHandler<DEV, D, CMD_KIND_GET_ARRAY, true> {
+		typedef bool (DEV::*type)(prot_chan_t __chan, bool __beforeGetFlag, typename D::value_type*& __pArr, prot_size_t& __size);
+		template <type FN>
+		static bool call(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processChannelGetArray<typename D::value_type>(__cmd, FN);
+		}
+	};
+
+	/** Command table entry for descriptor D handled by FN. The command byte
+	comes from the descriptor and FN must have the signature it requires.
+	\ingroup HexProtocol */
+	template <class DEV, class D, typename SchemaHandler<DEV, D>::type FN>
+	constexpr typename DEV::CommandEntry schemaEntry() {
+		return { D::cmd, &SchemaHandler<DEV, D>::template call<FN> };
+	}
+
+	///@}
+	/////////////////////////////////////////////////////////////////////////
+
+}; // namespace hprot
@@ -103,6 +103,7 @@ friend class DeviceHexProtocol<MyDevice>;
 		int ret = testProtocol();
 		if (ret != DEVICE_OK)
 			return ret;
+		negotiateCaps();
 		...
 		remoteValue_.createRemoteProp(this, this, infoValue, 
 			CommandSet::build().withSet(SET_VALUE).withGet(GET_VALUE));
@@ -138,14 +139,96 @@ class MyDevice : public CGenericBase<MyDevice>, public DeviceHexProtocol<MyDevic
 };
 \endcode
 
+Port detection
+==================
+
+tryStream() checks a single port and tryStreams() checks several ports at
+once. Slaves should call announceReady() at the end of setup() so the host
+does not have to wait out the whole bootloader delay.
+
+detectStream() first tries the last port and baud rate that worked for the
+device (see \ref AboutStreamCache), and only scans every port if that fails.
+A hub's DetectDevice() should call detectStream() with the port Micro-Manager
+asks about, so the cached baud rate is tried before the others.
+Override firmwareFingerprint() so a firmware change also forces a rescan.
+
+Resynchronization
+==================
+
+A timed out read or a reply to the wrong command means host and slave are out
+of step. At the end of that transaction the host sends the PROT_SYNC escape
+with a fresh nonce and discards everything up to the slave's matching reply,
+so the next transaction starts clean after one round trip. Slaves without
+CAP_FAM_SYNC get the old purge of the serial port instead.
+
+Answer timeouts
+==================
+
+The port's AnswerTimeout is the longest any read may wait. DeviceHexProtocol
+times every command, from the command byte to the last token read before
+the next command, and keeps a running mean and deviation for each command
+byte (see LatencyEstimate). Once a command has been seen a few times, its
+reads use a timeout of the mean plus four deviations, so a dead slave is 
+noticed in milliseconds rather than after the full AnswerTimeout. A timeout 
+forgets the estimate, and the command goes back to the full AnswerTimeout.
+
+Commands that sometimes take much longer than usual, such as homing tasks, 
+should get a fixed timeout with setCommandTimeout() or 
+CommandSet::withTimeout(). Use setAdaptiveTimeouts(false) to always use the
+port's AnswerTimeout. The timeouts are applied by changing the port's AnswerTimeout,
+and endProtocol() puts back the value startProtocol() found.
+
+Link monitoring
+==================
+
+startHeartbeat() starts a background thread that sends PROT_SYS_HEARTBEAT 
+whenever the stream has been idle for the heartbeat interval, so it never
+delays a real command. linkHealth() reports whether the last heartbeat was
+answered and the slave's uptime. If the uptime goes back, the slave has reset
+and lost its settings. linkEpoch() is then incremented, and remote 
+properties with a set command send their cached value again before their 
+next action (see RemotePropBase::refreshIfStale()). Slaves without 
+CAP_FAM_HEARTBEAT are pinged instead, which shows whether the link is up but
+cannot detect a reset.
+
+If upgradeBaudRate() switched to a faster baud rate, a slave that resets
+comes back at its power-on baud rate. After a missed heartbeat the host
+looks for it there, counts a reset and renegotiates the capabilities.
+Call upgradeBaudRate() again to get the faster rate back.
+
+Call stopHeartbeat() (or endProtocol()) in the device's Shutdown(). The
+heartbeat thread uses the device, which is already gone by the time
+~DeviceHexProtocol() runs.
+
 Logging
 ==================
 
 Serial transactions are logged if LOG_DEVICE_HEX_PROTOCOL is \c \#defined
 before \c \#include "DeviceHexProtocol"
 
+Sends and receives are recorded as binary records in a fixed-size
+TransactionCapture ring buffer (see \ref AboutProtocolCapture). Recording
+costs a clock read and a memcpy, so logging may stay on in production.
+\c \#define LOG_DEVICE_HEX_PROTOCOL_RECORDS to change the ring size
+(default 4096 records of 32 bytes).
+
 use getLastLog() to get a string containing the atomic
 results of the last get property or set property operation.
+The string is rendered from the ring buffer on demand.
+
+use dumpCapture() to write the whole ring to a compact binary file, 
+which can be decoded offline with hprot::decodeCapture() or the
+HexCaptureDecode tool.
+
+\c \#define TRACE_DEVICE_HEX_PROTOCOL to record Chrome trace-event spans of
+transactions, stream lock waits and remote property actions
+(see \ref AboutProtocolTrace). Use startTrace(), stopTrace() and writeTrace().
+
+use startAsyncLog() to also forward every transaction to LogMessage.
+Records are handed to a lock-free queue and formatted on a background
+thread (see \ref AboutAsyncLogSink), so the I/O path never waits on the
+core logger. Call stopAsyncLog() (or endProtocol()) before the device is
+destroyed.
 
 - A command sequence start with a single command character 
   and its hex equivalent. ie "A=0x41:" represents the single
@@ -221,6 +304,25 @@ Logging Examples
 #include "DeviceError.h"
 #include "DeviceBase.h"
 #include "HexProtocol.h"
+#include "StreamCache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef LOG_DEVICE_HEX_PROTOCOL
+#include "ProtocolCapture.h"
+#include "AsyncLogSink.h"
+#include <fstream>
+#endif
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+#include "ProtocolTrace.h"
+#include <fstream>
+#endif
 
 /** 
 \ingroup	DeviceHexProtocol
@@ -240,6 +342,20 @@ class MyDevice : public DeviceHexProtocol<MyDevice> {
 #define USE_DEVICE_FRIEND_METHOD	0
 #endif
 
+/** \ingroup	DeviceHexProtocol
+Number of records in the transaction capture ring when LOG_DEVICE_HEX_PROTOCOL
+is defined. Must be a power of two. */
+#ifndef LOG_DEVICE_HEX_PROTOCOL_RECORDS
+#define LOG_DEVICE_HEX_PROTOCOL_RECORDS	4096
+#endif
+
+/** \ingroup	DeviceHexProtocol
+Number of records in the asynchronous log queue used by startAsyncLog().
+Must be a power of two. */
+#ifndef LOG_DEVICE_HEX_PROTOCOL_ASYNC_RECORDS
+#define LOG_DEVICE_HEX_PROTOCOL_ASYNC_RECORDS	1024
+#endif
+
 namespace hprot {
 
 	////////////////////////////////////////////////////////////////
@@ -253,10 +369,77 @@ namespace hprot {
 	const char* const g_SerialHandshaking = "Off";
 	const char* const g_SerialAnswerTimeout = "500.0";
 	const char* const g_SerialDelayBetweenCharsMs = "0";
+	const long g_SerialReadyTimeoutMs = 2500;		///< longest wait for the slave's PROT_READY after opening a port
+	const long g_SerialReadyPollMs = 10;			///< how often to poll ports for PROT_READY
+	const long g_SerialReadyPingMs = 100;			///< how often to PING ports that have not sent PROT_READY
+	const long g_SerialMinAnswerTimeoutMs = 20;		///< shortest adaptive answer timeout
+	const unsigned g_SerialLatencySamples = 4;		///< commands timed before the adaptive timeout is used
+	const long g_HeartbeatIntervalMs = 1000;		///< default idle time between heartbeats
+	const long g_HeartbeatSlackMs = 250;			///< uptime may run this far ahead of the host clock before it counts as a reset
+
+	/** Baud rates tried by upgradeBaudRate(), fastest first. */
+	const long g_SerialUpgradeBaudRates[] = { 2000000, 1000000, 500000, 250000, 230400, 115200 };
 
 	///@}
 	////////////////////////////////////////////////////////////////
 
+	/** Running estimate of one command's answer latency.
+	\ingroup DeviceHexProtocol
+
+	Uses the smoothed mean and mean deviation of TCP's retransmit timer
+	(RFC 6298), which settles quickly and reacts to a slow command without
+	being thrown by a single outlier. */
+	struct LatencyEstimate {
+		double meanMs;		///< smoothed latency
+		double devMs;		///< smoothed mean deviation
+		unsigned samples;	///< commands timed so far
+		long fixedMs;		///< fixed timeout set by setCommandTimeout(), or 0
+
+		LatencyEstimate() : meanMs(0), devMs(0), samples(0), fixedMs(0) { }
+
+		/** Add one timed command. */
+		void add(double __ms) {
+			if (samples++ == 0) {
+				meanMs = __ms;
+				devMs = __ms / 2;
+			} else {
+				double err = __ms - meanMs;
+				meanMs += err / 8;
+				devMs += ((err < 0 ? -err : err) - devMs) / 4;
+			}
+		}
+
+		/** Forget the estimate after a timeout. */
+		void reset() {
+			meanMs = devMs = 0;
+			samples = 0;
+		}
+
+		/** The answer timeout for this command, at most __maxMs. */
+		long timeoutMs(long __maxMs) const {
+			if (fixedMs > 0) {
+				return fixedMs;
+			}
+			if (samples < g_SerialLatencySamples) {
+				return __maxMs;
+			}
+			long ms = static_cast<long>(meanMs + 4 * devMs) + 1;
+			return ms < g_SerialMinAnswerTimeoutMs ? g_SerialMinAnswerTimeoutMs : (ms > __maxMs ? __maxMs : ms);
+		}
+	};
+
+	/** State of the link as seen by the heartbeat.
+	\ingroup DeviceHexProtocol */
+	struct LinkHealth {
+		bool alive;					///< was the last heartbeat answered?
+		std::uint32_t beats;		///< heartbeats answered
+		std::uint32_t misses;		///< heartbeats not answered
+		std::uint32_t resets;		///< slave resets detected
+		prot_ulong_t uptimeMs;		///< slave uptime at the last heartbeat
+
+		LinkHealth() : alive(false), beats(0), misses(0), resets(0), uptimeMs(0) { }
+	};
+
 	/** Micromanager Devices just need the serial port name for writing streams.
 	\ingroup DeviceHexProtocol */
 	typedef std::string STREAM_T;
@@ -275,12 +458,14 @@ namespace hprot {
 	functions to get around this protected access limitation.
 
 	@tparam DEV MicroManager device implementing the protocol
+	@tparam CODEC value codec, which must match the slave's. @see AboutCodecs
 
 	*/
-	template <class DEV>
-	class DeviceHexProtocol : public HexProtocolBase<DEV,STREAM_T> {
+	template <class DEV, class CODEC = PROT_CODEC>
+	class DeviceHexProtocol : public HexProtocolBase<DEV, STREAM_T, CODEC> {
 	protected:
-		typedef HexProtocolBase<DEV, STREAM_T> BaseClass;
+		typedef HexProtocolBase<DEV, STREAM_T, CODEC> BaseClass;
+		friend BaseClass;	// for PROT_STATIC_DISPATCH
 
 	public:
 
@@ -389,46 +574,82 @@ namespace hprot {
 		///
 		///@{
 
-		/** End communication. Resets the port name to "Undefined". */
-		void endProtocol() override {
+		/** Start communication. Forgets the command latencies of any previous port
+		and saves the port's AnswerTimeout, which endProtocol() restores. */
+		void startProtocol(DEV* __target, STREAM_T& __stream) PROT_IO_OVERRIDE {
+			stopHeartbeat();
+			BaseClass::startProtocol(__target, __stream);
+			for (LatencyEstimate& est : latency_) {
+				long fixedMs = est.fixedMs;
+				est = LatencyEstimate();
+				est.fixedMs = fixedMs;
+			}
+			timing_ = false;
+			maxTimeoutMs_ = 0;
+			timeoutMs_ = 0;
+			maxAnswerTimeout();
+			link_ = LinkHealth();
+			powerOnBaud_ = 0;
+			upgradedBaud_ = 0;
+		}
+
+		/** Stops the heartbeat and the async log. The DEV part is already destroyed
+		here, so devices must stop both in Shutdown(). Debug builds assert that
+		the heartbeat was stopped. */
+		PROT_IO_VIRTUAL ~DeviceHexProtocol() {
+			assert(!heartbeatRunning_.load() && "call stopHeartbeat() or endProtocol() in the device's Shutdown()");
+			stopHeartbeat();
+#ifdef LOG_DEVICE_HEX_PROTOCOL
+			// drop whatever is still queued instead of logging it to the dead device
+			logTarget_.store(nullptr);
+			logSink_.stop();
+#endif
+		}
+
+		/** End communication. Restores the port's AnswerTimeout and resets the 
+		port name to "Undefined". */
+		void endProtocol() PROT_IO_OVERRIDE {
+			stopHeartbeat();
+			stopAsyncLog();
+			if (BaseClass::hasStarted() && BaseClass::target_) {
+				// adaptive timeouts must not ratchet down the next session's maxAnswerTimeout()
+				setAnswerTimeout(maxTimeoutMs_);
+			}
 			BaseClass::target_ = nullptr;
 			BaseClass::stream_ = g_SerialUndefinedPort;
 			BaseClass::endProtocol();
 		}
 
 		/** Write a single byte to the serial port. */
-		bool writeByte(prot_byte_t b) override {
+		bool writeByte(prot_byte_t b) PROT_IO_OVERRIDE {
 			if (!BaseClass::hasStarted()) {
 				return false;
 			}
+			unsigned char buf = static_cast<unsigned char>(b);
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-			std::ostringstream os;
-			os << "writeByte: " << std::hex << b;
-			accessor::callLogMessage(BaseClass::target_, os.str().c_str());
-			// clear the dispatch log
-			if (!protoLogStream_.str().empty()) {
-			// indicate end of last command with an @ symbol
-				protoLogStream_ << "@ ";
+			capture_.record(CAPTURE_CMD, reinterpret_cast<const char*>(&buf), 1);
+#endif
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			if (traceCommands_++ == 0) {
+				traceEvent_.cmd = buf;
 			}
-			protoLogStream_ << b << "=0x" << std::hex << int(b) << ": ";
+			traceEvent_.sent++;
 #endif
-			unsigned char buf = static_cast<unsigned char>(b);
 			return (DEVICE_OK == accessor::callWriteToComPort(BaseClass::target_, BaseClass::stream_.c_str(), &buf, 1));
 		}
 
 		/** Write several bytes to the output. The term character should be included
 			in the buffer, or you can use a single writeByte() to write
 			the term character. */
-		size_t writeBuffer(const char* buffer, size_t size) override {
+		size_t writeBuffer(const char* buffer, size_t size) PROT_IO_OVERRIDE {
 			if (!BaseClass::hasStarted()) {
 				return 0;
 			}
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-			std::ostringstream os;
-			std::string str(buffer, size);
-			os << "writeBuffer: " << size << ":[" << str << "]";
-			accessor::callLogMessage(BaseClass::target_, os.str().c_str());
-			protoLogStream_ << "[" << str << "] ";
+			capture_.record(CAPTURE_SEND, buffer, size);
+#endif
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			traceEvent_.sent += static_cast<std::uint32_t>(size);
 #endif
 			if (DEVICE_OK == accessor::callWriteToComPort(BaseClass::target_, BaseClass::stream_.c_str(), 
 					reinterpret_cast<const unsigned char*>(buffer), static_cast<unsigned>(size))) {
@@ -440,23 +661,19 @@ namespace hprot {
 
 		/** Read a string of bytes from the input UNTIL a terminator character is received, or a
 			timeout occurrs. The terminator character is NOT added to the end of the buffer. */
-		size_t readBufferUntilTerminator(char* buffer, size_t size, char terminator) override {
+		size_t readBufferUntilTerminator(char* buffer, size_t size, char terminator) PROT_IO_OVERRIDE {
 			if (!BaseClass::hasStarted()) {
 				return 0;
 			}
 			std::string answer;
 			char termString[2] = {terminator, '\0'};
-#ifdef LOG_DEVICE_HEX_PROTOCOL
-			std::ostringstream os;
-			os << "readBufferUntilTerminator: ";
-#endif
 			// NOTE: callGetSerialAnswer returns answer string without the terminating characters
 			if (DEVICE_OK != accessor::callGetSerialAnswer(BaseClass::target_, BaseClass::stream_.c_str(), termString, answer)) {
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-				os << "{empty}";
-				accessor::callLogMessage(BaseClass::target_, os.str().c_str());
-				protoLogStream_ << "{empty} ";
+				capture_.record(CAPTURE_RECV_EMPTY, nullptr, 0);
 #endif
+				noteDesync();
+				noteTimeout();
 				return 0;
 			}
 			size_t bytesRead = answer.copy(buffer, size);
@@ -469,10 +686,12 @@ namespace hprot {
 			if (bytesRead < size) {
 				buffer[bytesRead] = '\0';
 			}
+			lastRead_ = std::chrono::steady_clock::now();
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-			os << bytesRead << ":{" << answer << terminator << "}";
-			accessor::callLogMessage(BaseClass::target_, os.str().c_str());
-			protoLogStream_ << "{" << answer << terminator << "} ";
+			capture_.record(CAPTURE_RECV, answer.data(), answer.length(), terminator);
+#endif
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			traceEvent_.recv += static_cast<std::uint32_t>(answer.length() + 1);
 #endif
 			return bytesRead;
 		}
@@ -481,29 +700,27 @@ namespace hprot {
 		received, or a timeout occurrs. The terminator character is NOT added to the end
 		of the string, but the string is null terminated. readStringUntilTerminator
 		is primarily used for getValue<prot_string_t>(). */
-		size_t readStringUntilTerminator(prot_string_t& str, char terminator) {
+		size_t readStringUntilTerminator(prot_string_t& str, char terminator) PROT_IO_OVERRIDE {
 			if (!BaseClass::hasStarted()) {
 				return 0;
 			}
 			char termString[2] = { terminator, '\0' };
-#ifdef LOG_DEVICE_HEX_PROTOCOL
-			std::ostringstream os;
-			os << "readBufferUntilTerminator: ";
-#endif
 			// NOTE: callGetSerialAnswer returns answer string without the terminating characters
 			if (DEVICE_OK != accessor::callGetSerialAnswer(BaseClass::target_, BaseClass::stream_.c_str(), termString, str)) {
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-				os << "{empty}";
-				accessor::callLogMessage(BaseClass::target_, os.str().c_str());
-				protoLogStream_ << "{empty} ";
+				capture_.record(CAPTURE_RECV_EMPTY, nullptr, 0);
 #endif
+				noteDesync();
+				noteTimeout();
 				return 0;
 			}
 			size_t bytesRead = str.length();
+			lastRead_ = std::chrono::steady_clock::now();
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-			os << bytesRead << ":{" << str << terminator << "}";
-			accessor::callLogMessage(BaseClass::target_, os.str().c_str());
-			protoLogStream_ << "{" << str << terminator << "} ";
+			capture_.record(CAPTURE_RECV, str.data(), bytesRead, terminator);
+#endif
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			traceEvent_.recv += static_cast<std::uint32_t>(bytesRead + 1);
 #endif
 			return bytesRead;
 		}
@@ -517,29 +734,120 @@ namespace hprot {
 		///@{
 
 
-		/** Lock the stream and Resets logging of serial commands to a stringstream */
-		void lockStream() override {
+		/** Lock the stream and mark the start of a transaction in the capture log.
+		Nested locks (such as a StreamGuard inside another StreamGuard) belong
+		to the outermost transaction. */
+		void lockStream() PROT_IO_OVERRIDE {
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			std::uint64_t waitStart = trace_.enabled() ? captureClock() : 0;
+#endif
 			lock_.Lock();
+			if (lockDepth_++ > 0) {
+				return;
+			}
+			lockOwner_.store(std::this_thread::get_id());
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-			protoLogStream_.str("");
+			transactionStart_ = capture_.sequence();
+			capture_.begin();
+#endif
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			traceEvent_ = TraceEvent();
+			traceCommands_ = 0;
+			if (waitStart) {
+				traceEvent_.start = captureClock();
+				if (traceEvent_.start - waitStart >= TRACE_DEVICE_HEX_PROTOCOL_MIN_WAIT_US * 1000ULL) {
+					TraceEvent wait;
+					wait.name = "lock wait";
+					wait.cat = "lock";
+					wait.start = waitStart;
+					wait.dur = traceEvent_.start - waitStart;
+					trace_.add(wait);
+				}
+			}
 #endif
 		}
 
-		/** Unlocks the stream and finishes logging serial commands and write them to a string.
-		A device can read this log string with getLastLog()
+		/** Note the channel of a channel command for the trace. */
+		void noteChannel(prot_chan_t __chan) PROT_IO_OVERRIDE {
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			traceEvent_.chan = __chan;
+#endif
+		}
+
+		/** Start timing __cmd and set the answer timeout for its reads. */
+		void noteCommand(prot_cmd_t __cmd) PROT_IO_OVERRIDE {
+			finishTiming();
+			if (!BaseClass::hasStarted()) {
+				return;
+			}
+			const LatencyEstimate& est = latency_[__cmd];
+			if (!adaptiveTimeouts_) {
+				setAnswerTimeout(est.fixedMs > 0 ? est.fixedMs : maxAnswerTimeout());
+				return;
+			}
+			timing_ = true;
+			timingCmd_ = __cmd;
+			commandStart_ = lastRead_ = std::chrono::steady_clock::now();
+			setAnswerTimeout(est.timeoutMs(maxAnswerTimeout()));
+		}
+
+		/** A late or missing reply leaves the slave's answer in the input. Resync
+		when the transaction ends. */
+		void noteDesync() PROT_IO_OVERRIDE {
+			if (!resyncing_) {
+				desync_ = true;
+			}
+		}
+
+		/** Mark the end of the transaction in the capture log and unlock the stream.
+		A device can read this transaction as a string with getLastLog()
 		*/
-		void unlockStream() override {
-			lock_.Unlock();
+		void unlockStream() PROT_IO_OVERRIDE {
+			if (--lockDepth_ > 0) {
+				lock_.Unlock();
+				return;
+			}
+			finishTiming();
+			if (desync_) {
+				resync();
+			}
+			lastActivity_.store(std::chrono::steady_clock::now().time_since_epoch().count());
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			if (traceEvent_.start && traceCommands_ > 0) {
+				traceEvent_.dur = captureClock() - traceEvent_.start;
+				traceEvent_.commands = traceCommands_;
+				traceEvent_.cat = "transaction";
+				char name[16];
+				snprintf(name, sizeof(name), "%c=0x%02x", isprint(traceEvent_.cmd) ? traceEvent_.cmd : '?', traceEvent_.cmd);
+				traceEvent_.name = name;
+				trace_.add(traceEvent_);
+			}
+#endif
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-			lastProtoLog_ = protoLogStream_.str();
+			capture_.end();
+			if (logSink_.running()) {
+				// queue the raw records while the stream is still locked, so 
+				// transactions reach the sink whole and in order. A push never 
+				// blocks or allocates
+				std::uint64_t end = capture_.sequence();
+				std::uint64_t begin = end - transactionStart_ > LOG_DEVICE_HEX_PROTOCOL_RECORDS
+					? end - LOG_DEVICE_HEX_PROTOCOL_RECORDS : transactionStart_;
+				for (std::uint64_t seq = begin; seq < end; seq++) {
+					if (!logSink_.push(capture_.at(seq))) {
+						break;
+					}
+				}
+			}
 #endif
+			lockOwner_.store(std::thread::id());
+			lock_.Unlock();
 		}
 
 		/** Retrive a string containing commands and values
 		sent and received over the last transaction. */
 		std::string getLastLog() const {
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-			return lastProtoLog_;
+			return renderTransaction(capture_.lastTransaction());
 #else
 			return std::string();
 #endif
@@ -548,9 +856,214 @@ namespace hprot {
 		/** Clears the transaction log. */
 		void clearLastLog() {
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-			protoLogStream_.str("");
-			lastProtoLog_.clear();
+			capture_.clear();
+#endif
+		}
+
+		/** Write the transaction capture ring to a compact binary file.
+		Decode it offline with hprot::decodeCapture().
+		@return true if the file was written */
+		bool dumpCapture(const char* __fileName) const {
+#ifdef LOG_DEVICE_HEX_PROTOCOL
+			std::ofstream os(__fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			return os.is_open() && capture_.dump(os);
+#else
+			return false;
+#endif
+		}
+
+		/** Start forwarding every transaction to LogMessage from a background thread.
+		Must be called after startProtocol(). Does nothing unless 
+		LOG_DEVICE_HEX_PROTOCOL is \c \#defined.
+		@param __debugOnly	passed on to LogMessage */
+		void startAsyncLog(bool __debugOnly = true) {
+#ifdef LOG_DEVICE_HEX_PROTOCOL
+			if (BaseClass::target_) {
+				logTarget_.store(BaseClass::target_);
+				// the sink is our member and stopped by our destructor, so this outlives it
+				logSink_.start([this, __debugOnly](const std::string& __msg) {
+					DEV* target = logTarget_.load();
+					if (target) {
+						accessor::callLogMessage(target, __msg, __debugOnly);
+					}
+				});
+			}
+#endif
+		}
+
+		/** Log any queued transactions and stop the background log thread. */
+		void stopAsyncLog() {
+#ifdef LOG_DEVICE_HEX_PROTOCOL
+			logSink_.stop();
+			logTarget_.store(nullptr);
+#endif
+		}
+
+		/** Start recording trace spans. Does nothing unless 
+		TRACE_DEVICE_HEX_PROTOCOL is \c \#defined.
+		@param __clear	forget any spans recorded earlier */
+		void startTrace(bool __clear = true) {
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			if (__clear) {
+				trace_.clear();
+			}
+			trace_.enable(true);
+#endif
+		}
+
+		/** Stop recording trace spans. */
+		void stopTrace() {
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			trace_.enable(false);
+#endif
+		}
+
+		/** Write the recorded spans as Chrome trace-event JSON.
+		Open the file in chrome://tracing or https://ui.perfetto.dev
+		@return true if the file was written */
+		bool writeTrace(const char* __fileName) const {
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			std::ofstream os(__fileName, std::ios::out | std::ios::trunc);
+			return os.is_open() && trace_.writeJson(os);
+#else
+			return false;
+#endif
+		}
+
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+		/** The trace recorder, for adding extra spans with TraceSpan. */
+		TraceRecorder* traceRecorder() {
+			return &trace_;
+		}
 #endif
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Link Monitoring
+		///
+		///@{
+
+		/** Send a heartbeat whenever the stream has been idle for __intervalMs.
+		Must be called after startProtocol(), outside of any StreamGuard. */
+		void startHeartbeat(long __intervalMs = g_HeartbeatIntervalMs) {
+			if (heartbeatRunning_.load()) {
+				return;
+			}
+			if (heartbeatThread_.joinable()) {
+				// stopped inside a StreamGuard and not joined yet
+				heartbeatThread_.join();
+			}
+			heartbeatMs_ = __intervalMs;
+			heartbeatRunning_.store(true);
+			heartbeatThread_ = std::thread(&DeviceHexProtocol::heartbeatLoop, this);
+		}
+
+		/** Stop the heartbeat thread. Inside a StreamGuard the thread is only told
+		to stop, since a beat may be waiting for the stream. It is joined by the
+		next startHeartbeat() or stopHeartbeat() outside of a StreamGuard. */
+		void stopHeartbeat() {
+			{
+				std::lock_guard<std::mutex> lock(heartbeatMutex_);
+				heartbeatRunning_.store(false);
+			}
+			heartbeatWake_.notify_one();
+			if (heartbeatThread_.joinable() && lockOwner_.load() != std::this_thread::get_id()) {
+				heartbeatThread_.join();
+			}
+		}
+
+		/** Send one heartbeat now and update linkHealth().
+		@return true if the slave answered */
+		bool heartbeat() {
+			typename BaseClass::StreamGuard guard(this);
+			if (!BaseClass::hasStarted()) {
+				return false;
+			}
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			prot_ulong_t uptime = 0;
+			bool hasUptime = (ensureCaps().families & CAP_FAM_HEARTBEAT) != 0;
+			bool ok = hasUptime ? BaseClass::dispatchGet(PROT_SYS_HEARTBEAT, uptime)
+				: BaseClass::dispatchTask(PROT_SYS_PING);
+			if (!ok && recoverPowerOnBaud()) {
+				accessor::callLogMessage(BaseClass::target_, "heartbeat: slave reset to its power-on baud rate", false);
+				link_.resets++;
+				linkEpoch_++;
+				link_.alive = true;
+				link_.beats = 0;
+				return true;
+			}
+			if (!ok) {
+				if (link_.alive) {
+					accessor::callLogMessage(BaseClass::target_, "heartbeat: link lost", false);
+				}
+				link_.alive = false;
+				link_.misses++;
+				return false;
+			}
+			if (hasUptime && link_.beats > 0) {
+				// unsigned difference, so a millis() wrap-around is not a reset
+				long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastBeat_).count();
+				if (static_cast<prot_ulong_t>(uptime - link_.uptimeMs) > elapsed + g_HeartbeatSlackMs) {
+					accessor::callLogMessage(BaseClass::target_, "heartbeat: slave reset", false);
+					link_.resets++;
+					linkEpoch_++;
+					// the slave is back to the legacyCaps()
+					negotiateCaps();
+				}
+			}
+			link_.alive = true;
+			link_.beats++;
+			link_.uptimeMs = uptime;
+			lastBeat_ = now;
+			return true;
+		}
+
+		/** Link state as of the last heartbeat. */
+		LinkHealth linkHealth() {
+			typename BaseClass::StreamGuard guard(this);
+			return link_;
+		}
+
+		/** Incremented whenever the heartbeat sees the slave reset. Anything 
+		cached from an older epoch should be sent to the slave again. */
+		unsigned linkEpoch() const {
+			return linkEpoch_.load();
+		}
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Answer Timeouts
+		///
+		///@{
+
+		/** Turn the adaptive per-command answer timeouts on or off. 
+		When off, every read uses the port's AnswerTimeout. */
+		void setAdaptiveTimeouts(bool __adaptive) {
+			typename BaseClass::StreamGuard guard(this);
+			adaptiveTimeouts_ = __adaptive;
+		}
+
+		/** Are adaptive answer timeouts on? */
+		bool adaptiveTimeouts() const {
+			return adaptiveTimeouts_;
+		}
+
+		/** Always use __timeoutMs for __cmd, for instance for a slow homing task,
+		whether or not adaptive timeouts are on.
+		Set __timeoutMs to 0 to go back to the adaptive timeout. */
+		void setCommandTimeout(prot_cmd_t __cmd, long __timeoutMs) {
+			typename BaseClass::StreamGuard guard(this);
+			latency_[__cmd].fixedMs = __timeoutMs;
+		}
+
+		/** The latency estimate for __cmd. */
+		LatencyEstimate commandLatency(prot_cmd_t __cmd) {
+			typename BaseClass::StreamGuard guard(this);
+			return latency_[__cmd];
 		}
 
 		///@}
@@ -563,13 +1076,31 @@ namespace hprot {
 
 		/** Helper method to clears the serial port buffers	*/
 		int purgeComPort() {
-			BaseClass::StreamGuard(this);
+			typename BaseClass::StreamGuard guard(this);
 			if (!BaseClass::hasStarted()) {
 				return ERR_NO_PORT_SET;
 			}
 			return accessor::callPurgeComPort(BaseClass::target_, BaseClass::stream_.c_str());
 		}
 
+		/** Bring host and slave back in step after a desync. Called by unlockStream() 
+		with the stream still locked. Uses PROT_SYNC if the slave supports it, 
+		otherwise purges the serial port.
+		@return true if the slave answered the sync */
+		bool resync() {
+			desync_ = false;
+			if (!BaseClass::hasStarted()) {
+				return false;
+			}
+			resyncing_ = true;
+			bool synced = BaseClass::hasFamily(CAP_FAM_SYNC) && BaseClass::dispatchSync(++syncCount_);
+			resyncing_ = false;
+			if (!synced) {
+				accessor::callPurgeComPort(BaseClass::target_, BaseClass::stream_.c_str());
+			}
+			return synced;
+		}
+
 		/** Implementation-specific function that detects whether a slave device is present
 		on the stream during a tryStream.
 
@@ -583,6 +1114,15 @@ namespace hprot {
 		*/
 		virtual int testProtocol() = 0;
 
+		/** Implementation-specific string that identifies the slave's firmware, such as
+		its name and version. Called right after a successful testProtocol() and 
+		negotiateCaps(), so it may include caps().version. Stored 
+		in the StreamCache by detectStream(). A cached port whose fingerprint no longer 
+		matches is rescanned. The default is an empty string, which matches anything. */
+		virtual std::string firmwareFingerprint() {
+			return std::string();
+		}
+
 		/** Used by DEV::DetectDevice to determine if a given serial port is actively
 			connected to a valid slave device. 
 		
@@ -591,9 +1131,13 @@ namespace hprot {
 			tryStream(DEV* __target, std::string __stream, long __baudRate) 
 			{
 				... // Call a series of methods that boil down to __target->setupStreamPort(__stream);
+				... // wait for the slave to announce PROT_READY, or __readyTimeoutMs
 				this->startProtocol(__target, __stream);
 				this->purgeComPort();
 				int ret = this->testProtocol();
+				if (ret == DEVICE_OK) {
+					this->negotiateCaps();
+				}
 				this->endProtocol();
 				if (ret == DEVICE_OK) {
 					... // cleanup __target
@@ -610,72 +1154,537 @@ namespace hprot {
 			@param __target	pointer to device to check
 			@param __stream serial port name to check, usually taken from some preInit "port" property.
 			@param __baudRate baud-rate to try (must be same as Arudino Serial.begin(baudRate) setting.
-			healthy slave device on this __stream.
+			@param __readyTimeoutMs longest time to wait for the slave to announce itself after
+			the port is opened. Slaves that do not reset on open (or older firmware that
+			never calls announceReady()) are tested after this timeout.
 			@return @see MM::DeviceDetectionStatus
 		*/
-		MM::DeviceDetectionStatus tryStream(DEV* __target, std::string __stream, long __baudRate) {
-			BaseClass::StreamGuard(this);
-			MM::DeviceDetectionStatus result = MM::Misconfigured;
-			char defaultAnswerTimeout[MM::MaxStrLength];
+		MM::DeviceDetectionStatus tryStream(DEV* __target, std::string __stream, long __baudRate, 
+				long __readyTimeoutMs = g_SerialReadyTimeoutMs) {
+			return tryStreams(__target, std::vector<std::string>(1, __stream), __baudRate, __readyTimeoutMs)[0];
+		}
+
+		/** Probe several candidate ports at once. 
+
+			All ports are opened first, so the bootloader delays of the slaves overlap.
+			Each port is then polled until its slave announces PROT_READY, answers a
+			PROT_SYS_PING, or __readyTimeoutMs expires, and finally testProtocol() is 
+			run on each port.
+			Scanning eight ports takes about as long as scanning one.
+
+			@param __target	pointer to device to check
+			@param __streams serial port names to check
+			@param __baudRate baud-rate to try on every port
+			@param __readyTimeoutMs see tryStream()
+			@param __fingerprints if not null, receives the firmwareFingerprint() of each
+			port that could communicate
+			@return one MM::DeviceDetectionStatus per entry of __streams
+		*/
+		std::vector<MM::DeviceDetectionStatus> tryStreams(DEV* __target, const std::vector<std::string>& __streams, 
+				long __baudRate, long __readyTimeoutMs = g_SerialReadyTimeoutMs, 
+				std::vector<std::string>* __fingerprints = nullptr) {
+			// before the guard, so a beat waiting for the stream can finish
+			stopHeartbeat();
+			typename BaseClass::StreamGuard guard(this);
+			size_t nstreams = __streams.size();
+			std::vector<MM::DeviceDetectionStatus> results(nstreams, MM::Misconfigured);
+			std::vector<MM::Device*> ports(nstreams, nullptr);
+			std::vector<std::string> defaultAnswerTimeouts(nstreams);
+			std::vector<bool> ready(nstreams, false);
+			if (__fingerprints) {
+				__fingerprints->assign(nstreams, std::string());
+			}
+			MM::Core* core = accessor::callGetCoreCallback(__target);
 			try {
-				// convert stream name to lower case
-				std::string streamLowerCase = __stream;
-				std::transform(streamLowerCase.begin(), streamLowerCase.end(), streamLowerCase.begin(), ::tolower);
-				if (0 < streamLowerCase.length() && 0 != streamLowerCase.compare("undefined") && 0 != streamLowerCase.compare("unknown")) {
-					const char* streamName = __stream.c_str();
-					result = MM::CanNotCommunicate;
-
-					MM::Core* core = accessor::callGetCoreCallback(__target);
-
-					// record the default answer time out
-					core->GetDeviceProperty(streamName, MM::g_Keyword_AnswerTimeout, defaultAnswerTimeout);
-
-					// device specific default communication parameters for Arduino
-					core->SetDeviceProperty(streamName, MM::g_Keyword_BaudRate, std::to_string(__baudRate).c_str());
-					core->SetDeviceProperty(streamName, MM::g_Keyword_DataBits, g_SerialDataBits);
-					core->SetDeviceProperty(streamName, MM::g_Keyword_Parity, g_SerialParity);
-					core->SetDeviceProperty(streamName, MM::g_Keyword_StopBits, g_SerialStopBits);
-					core->SetDeviceProperty(streamName, MM::g_Keyword_Handshaking, g_SerialHandshaking);
-					core->SetDeviceProperty(streamName, MM::g_Keyword_AnswerTimeout, g_SerialAnswerTimeout);
-					core->SetDeviceProperty(streamName, MM::g_Keyword_DelayBetweenCharsMs, g_SerialDelayBetweenCharsMs);
-					MM::Device* pS = core->GetDevice(__target, streamName);
-
-					pS->Initialize();
-
-					// The first second or so after opening the serial port, the Arduino is 
-					// waiting for firmwareupgrades.  Simply sleep 2 seconds.
-					CDeviceUtils::SleepMs(2000);
-					startProtocol(__target, __stream);
+				for (size_t i = 0; i < nstreams; i++) {
+					if (isStreamName(__streams[i])) {
+						results[i] = MM::CanNotCommunicate;
+						ports[i] = openStream(core, __target, __streams[i], __baudRate, defaultAnswerTimeouts[i]);
+					}
+				}
+				// The first second or so after opening the serial port, the Arduino is 
+				// waiting for firmware upgrades. Wait for all of them at once.
+				waitForReady(core, __target, __streams, ports, ready, __readyTimeoutMs);
+				for (size_t i = 0; i < nstreams; i++) {
+					if (!ports[i]) {
+						continue;
+					}
+					std::string stream = __streams[i];
+					startProtocol(__target, stream);
 					purgeComPort();
 					// Try the detection function
 					int ret = testProtocol();
 					if (ret == DEVICE_OK) {
 						// Device was detected!
-						result = MM::CanCommunicate;
+						results[i] = MM::CanCommunicate;
+						negotiateCaps();
+						if (__fingerprints) {
+							(*__fingerprints)[i] = firmwareFingerprint();
+						}
 					} else {
 						// Device was not detected. Keep result = MM::CanNotCommunicate
 						accessor::callLogMessageCode(__target, ret, true);
 					}
 					endProtocol();
-					pS->Shutdown();
-					// always restore the AnswerTimeout to the default
-					core->SetDeviceProperty(streamName, MM::g_Keyword_AnswerTimeout, defaultAnswerTimeout);
+					closeStream(core, ports[i], __streams[i], defaultAnswerTimeouts[i]);
+					ports[i] = nullptr;
 				}
 			} catch (...) {
 				accessor::callLogMessage(__target, "Exception in DetectDevice tryStream!", false);
+				for (size_t i = 0; i < nstreams; i++) {
+					if (ports[i]) {
+						closeStream(core, ports[i], __streams[i], defaultAnswerTimeouts[i]);
+					}
+				}
+			}
+			return results;
+		}
+
+		/** Find the slave's port, trying the last-known-good port first.
+
+			The StreamCache entry for __deviceName is tried with a single tryStream()
+			if its port is one of __streams. If that fails, or the firmware fingerprint 
+			changed, every port in __streams is scanned with tryStreams() at each baud 
+			rate in turn. Only the first scan waits for PROT_READY, since the slaves
+			have booted by the time it ends. A successful port is saved back to the cache.
+
+			A hub's DetectDevice() passes the single port Micro-Manager asks about, so
+			the cached baud rate is tried first:
+			\code{.cpp}
+			MM::DeviceDetectionStatus DetectDevice() {
+				std::vector<std::string> ports(1, propPort_.getCachedValue());
+				std::vector<long> baudRates = { 115200, 57600, 9600 };
+				std::string port;
+				long baudRate;
+				return detectStream(this, g_HubDeviceName, ports, baudRates, port, baudRate);
+			}
+			\endcode
+
+			@param __target	pointer to device to check
+			@param __deviceName cache key, usually the device name
+			@param __streams candidate port names for a full scan
+			@param __baudRates candidate baud rates for a full scan, most likely first
+			@param __stream receives the port that could communicate
+			@param __baudRate receives its baud rate
+			@return MM::CanCommunicate if a port was found
+		*/
+		MM::DeviceDetectionStatus detectStream(DEV* __target, const std::string& __deviceName,
+				const std::vector<std::string>& __streams, const std::vector<long>& __baudRates,
+				std::string& __stream, long& __baudRate) {
+			StreamCache cache;
+			StreamCacheEntry entry;
+			std::vector<std::string> fingerprints;
+			if (cache.load(__deviceName, entry) && std::find(__streams.begin(), __streams.end(), entry.stream) != __streams.end()) {
+				MM::DeviceDetectionStatus status = tryStreams(__target, std::vector<std::string>(1, entry.stream), 
+					entry.baudRate, g_SerialReadyTimeoutMs, &fingerprints)[0];
+				if (status == MM::CanCommunicate && StreamCache::matches(entry, fingerprints[0])) {
+					__stream = entry.stream;
+					__baudRate = entry.baudRate;
+					return status;
+				}
+				accessor::callLogMessage(__target, "Cached port failed, scanning all ports", true);
+			}
+			MM::DeviceDetectionStatus result = MM::CanNotCommunicate;
+			long readyTimeoutMs = g_SerialReadyTimeoutMs;
+			for (long baudRate : __baudRates) {
+				std::vector<MM::DeviceDetectionStatus> results = tryStreams(__target, __streams, 
+					baudRate, readyTimeoutMs, &fingerprints);
+				readyTimeoutMs = 0;
+				for (size_t i = 0; i < results.size(); i++) {
+					if (results[i] == MM::CanCommunicate) {
+						entry.device = __deviceName;
+						entry.stream = __streams[i];
+						entry.baudRate = baudRate;
+						entry.fingerprint = fingerprints[i];
+						cache.save(entry);
+						__stream = entry.stream;
+						__baudRate = baudRate;
+						return MM::CanCommunicate;
+					}
+					if (results[i] != MM::Misconfigured) {
+						result = results[i];
+					}
+				}
 			}
 			return result;
 		}
+
+		/** The host can change its baud rate and resync. */
+		ProtocolCaps localCaps() PROT_IO_OVERRIDE {
+			ProtocolCaps caps = BaseClass::localCaps();
+			caps.families |= CAP_FAM_BAUD | CAP_FAM_SYNC;
+			return caps;
+		}
+
+		/** Exchange capabilities with the slave and cache the result for this session.
+		Call once after testProtocol() succeeded, as tryStreams() does. Otherwise the
+		first heartbeat or baud upgrade negotiates them. Slaves without PROT_SYS_CAPS 
+		get the legacyCaps().
+		@return true if the slave reported its capabilities and uses our CODEC */
+		bool negotiateCaps() {
+			typename BaseClass::StreamGuard guard(this);
+			ProtocolCaps remote;
+			// older firmware fails the PING without mistaking our caps for commands
+			if (BaseClass::dispatchTask(PROT_SYS_PING) && BaseClass::dispatchCaps(localCaps(), remote)) {
+				if (!BaseClass::setCaps(remote)) {
+					accessor::callLogMessage(BaseClass::target_, "negotiateCaps: slave uses a different value codec", false);
+					return false;
+				}
+				return true;
+			}
+			purgeComPort();
+			BaseClass::setCaps(BaseClass::legacyCaps());
+			return false;
+		}
+
+		/** The session capabilities, negotiating them first if needed. */
+		const ProtocolCaps& ensureCaps() {
+			if (!BaseClass::capsKnown()) {
+				negotiateCaps();
+			}
+			return BaseClass::caps();
+		}
+
+		/** Try to switch host and slave to a faster baud rate.
+
+			Call after testProtocol() succeeded on a started protocol. Each candidate
+			faster than the current port baud rate is offered to the slave with 
+			PROT_SYS_BAUD. If the slave accepts, the host port is switched and the link 
+			is checked with PROT_SYS_PING, retried for up to half of PROT_BAUD_VERIFY_MS. 
+			On failure both sides fall back to the old baud rate and the next candidate 
+			is tried. If the host port cannot change its baud rate while open (see 
+			changeStreamBaudRate()), the slave is left to revert on its own and the
+			current rate is kept.
+
+			Nothing is offered unless the slave reports CAP_FAM_BAUD in its capabilities.
+
+			@param __candidates baud rates to try, fastest first
+			@return the baud rate in use afterwards, or 0 if the link was lost
+		*/
+		long upgradeBaudRate(const std::vector<long>& __candidates) {
+			typename BaseClass::StreamGuard guard(this);
+			if (!BaseClass::hasStarted()) {
+				return 0;
+			}
+			MM::Core* core = accessor::callGetCoreCallback(BaseClass::target_);
+			char buf[MM::MaxStrLength];
+			if (DEVICE_OK != core->GetDeviceProperty(BaseClass::stream_.c_str(), MM::g_Keyword_BaudRate, buf)) {
+				return 0;
+			}
+			long current = atol(buf);
+			if (!(ensureCaps().families & CAP_FAM_BAUD)) {
+				return current;
+			}
+			for (long baudRate : __candidates) {
+				if (baudRate <= current) {
+					continue;
+				}
+				if (!BaseClass::dispatchSet(PROT_SYS_BAUD, static_cast<prot_ulong_t>(baudRate), static_cast<prot_ulong_t>(current))) {
+					// slave refused this rate
+					continue;
+				}
+				int ret = changeStreamBaudRate(baudRate);
+				if (ret == DEVICE_UNSUPPORTED_COMMAND) {
+					// the port is still at the old rate. Wait for the slave to revert
+					accessor::callLogMessage(BaseClass::target_, "Port cannot change its baud rate while open, keeping the current rate", true);
+					return waitForPing(2 * PROT_BAUD_VERIFY_MS) ? current : 0;
+				}
+				if (DEVICE_OK == ret) {
+					// a freshly reopened port may drop the first PING, so keep trying
+					// for half the time the slave waits before reverting
+					if (waitForPing(PROT_BAUD_VERIFY_MS / 2)) {
+						if (powerOnBaud_ == 0) {
+							powerOnBaud_ = current;
+						}
+						upgradedBaud_ = baudRate;
+						return baudRate;
+					}
+				}
+				// fall back. The slave reverts on its own after PROT_BAUD_VERIFY_MS
+				accessor::callLogMessage(BaseClass::target_, "Baud rate upgrade failed, falling back", true);
+				if (DEVICE_OK != changeStreamBaudRate(current) || !waitForPing(2 * PROT_BAUD_VERIFY_MS)) {
+					return 0;
+				}
+			}
+			return current;
+		}
+
+		/** Try to switch to one of the g_SerialUpgradeBaudRates. @see upgradeBaudRate(const std::vector<long>&) */
+		long upgradeBaudRate() {
+			return upgradeBaudRate(std::vector<long>(std::begin(g_SerialUpgradeBaudRates), std::end(g_SerialUpgradeBaudRates)));
+		}
+
+		/** Change the baud rate of the open host port.
+		@return DEVICE_UNSUPPORTED_COMMAND if the port rejects the change. 
+
+		Most Micro-Manager serial ports only accept a new BaudRate before 
+		initialization. Reopening the port toggles DTR, which resets Uno and 
+		Nano-class boards back to their power-on baud rate, so it is not done by
+		default. Devices whose slave survives a reopen can override this to call
+		reopenStreamBaudRate(). */
+		virtual int changeStreamBaudRate(long __baudRate) {
+			MM::Core* core = accessor::callGetCoreCallback(BaseClass::target_);
+			std::string baud = std::to_string(__baudRate);
+			if (DEVICE_OK == core->SetDeviceProperty(BaseClass::stream_.c_str(), MM::g_Keyword_BaudRate, baud.c_str())) {
+				return DEVICE_OK;
+			}
+			return DEVICE_UNSUPPORTED_COMMAND;
+		}
+
+		/** Change the baud rate of the host port by shutting it down, setting the
+		BaudRate and initializing it again. @see changeStreamBaudRate() */
+		int reopenStreamBaudRate(long __baudRate) {
+			MM::Core* core = accessor::callGetCoreCallback(BaseClass::target_);
+			const char* streamName = BaseClass::stream_.c_str();
+			std::string baud = std::to_string(__baudRate);
+			if (DEVICE_OK == core->SetDeviceProperty(streamName, MM::g_Keyword_BaudRate, baud.c_str())) {
+				return DEVICE_OK;
+			}
+			MM::Device* pS = core->GetDevice(BaseClass::target_, streamName);
+			if (!pS) {
+				return ERR_NO_PORT_SET;
+			}
+			pS->Shutdown();
+			core->SetDeviceProperty(streamName, MM::g_Keyword_BaudRate, baud.c_str());
+			return pS->Initialize();
+		}
+
+		/** Ping the slave until it answers or __timeoutMs expires. */
+		bool waitForPing(long __timeoutMs) {
+			std::chrono::steady_clock::time_point deadline =
+				std::chrono::steady_clock::now() + std::chrono::milliseconds(__timeoutMs);
+			do {
+				purgeComPort();
+				if (BaseClass::dispatchTask(PROT_SYS_PING)) {
+					return true;
+				}
+			} while (std::chrono::steady_clock::now() < deadline);
+			return false;
+		}
 		///@}
 		/////////////////////////////////////////////////////////////////////////
 
 	protected:
+		/** Heartbeat thread. Only beats after __intervalMs without a transaction. */
+		void heartbeatLoop() {
+			std::chrono::milliseconds interval(heartbeatMs_);
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> lock(heartbeatMutex_);
+					if (heartbeatWake_.wait_for(lock, interval, [this] { return !heartbeatRunning_.load(); })) {
+						break;
+					}
+				}
+				std::chrono::steady_clock::duration idle = std::chrono::steady_clock::now().time_since_epoch() 
+					- std::chrono::steady_clock::duration(lastActivity_.load());
+				if (idle >= interval) {
+					typename BaseClass::StreamGuard guard(this);
+					// the stream's last owner may have stopped us
+					if (!heartbeatRunning_.load()) {
+						break;
+					}
+					heartbeat();
+				}
+			}
+		}
+
+		/** A slave that resets after upgradeBaudRate() comes back at its power-on
+		baud rate. After a missed heartbeat, look for it there, and go back to the
+		upgraded rate if it does not answer either.
+		@return true if the slave answered at the power-on baud rate */
+		bool recoverPowerOnBaud() {
+			if (upgradedBaud_ == 0) {
+				return false;
+			}
+			if (DEVICE_OK == changeStreamBaudRate(powerOnBaud_) && waitForPing(g_HeartbeatSlackMs)) {
+				upgradedBaud_ = 0;
+				negotiateCaps();
+				return true;
+			}
+			changeStreamBaudRate(upgradedBaud_);
+			return false;
+		}
+
+		/** Add the time of the command being timed to its estimate. */
+		void finishTiming() {
+			if (!timing_) {
+				return;
+			}
+			timing_ = false;
+			if (lastRead_ > commandStart_) {
+				latency_[timingCmd_].add(std::chrono::duration<double, std::milli>(lastRead_ - commandStart_).count());
+			}
+		}
+
+		/** A read timed out. Forget the estimate of the command being timed. */
+		void noteTimeout() {
+			if (timing_) {
+				timing_ = false;
+				latency_[timingCmd_].reset();
+			}
+		}
+
+		/** The port's configured AnswerTimeout, read by startProtocol(). */
+		long maxAnswerTimeout() {
+			if (maxTimeoutMs_ <= 0) {
+				MM::Core* core = accessor::callGetCoreCallback(BaseClass::target_);
+				char buf[MM::MaxStrLength];
+				maxTimeoutMs_ = (core && DEVICE_OK == core->GetDeviceProperty(BaseClass::stream_.c_str(), MM::g_Keyword_AnswerTimeout, buf))
+					? static_cast<long>(atof(buf)) : 0;
+				if (maxTimeoutMs_ <= 0) {
+					maxTimeoutMs_ = static_cast<long>(atof(g_SerialAnswerTimeout));
+				}
+				timeoutMs_ = maxTimeoutMs_;
+			}
+			return maxTimeoutMs_;
+		}
+
+		/** Change the port's AnswerTimeout if it differs from __ms. */
+		void setAnswerTimeout(long __ms) {
+			if (__ms == timeoutMs_) {
+				return;
+			}
+			MM::Core* core = accessor::callGetCoreCallback(BaseClass::target_);
+			if (core && DEVICE_OK == core->SetDeviceProperty(BaseClass::stream_.c_str(), 
+					MM::g_Keyword_AnswerTimeout, std::to_string(__ms).c_str())) {
+				timeoutMs_ = __ms;
+			}
+		}
+
+		/** Is __stream a real port name rather than "undefined" or "unknown"? */
+		static bool isStreamName(const std::string& __stream) {
+			// convert stream name to lower case
+			std::string streamLowerCase = __stream;
+			std::transform(streamLowerCase.begin(), streamLowerCase.end(), streamLowerCase.begin(), ::tolower);
+			return 0 < streamLowerCase.length() && 0 != streamLowerCase.compare("undefined") && 0 != streamLowerCase.compare("unknown");
+		}
+
+		/** Set the default Arduino port parameters and open the port.
+		The port's current AnswerTimeout is saved in __defaultAnswerTimeout. */
+		static MM::Device* openStream(MM::Core* __core, DEV* __target, const std::string& __stream, long __baudRate, 
+				std::string& __defaultAnswerTimeout) {
+			const char* streamName = __stream.c_str();
+			char defaultAnswerTimeout[MM::MaxStrLength];
+
+			// record the default answer time out
+			__core->GetDeviceProperty(streamName, MM::g_Keyword_AnswerTimeout, defaultAnswerTimeout);
+			__defaultAnswerTimeout = defaultAnswerTimeout;
+
+			// device specific default communication parameters for Arduino
+			__core->SetDeviceProperty(streamName, MM::g_Keyword_BaudRate, std::to_string(__baudRate).c_str());
+			__core->SetDeviceProperty(streamName, MM::g_Keyword_DataBits, g_SerialDataBits);
+			__core->SetDeviceProperty(streamName, MM::g_Keyword_Parity, g_SerialParity);
+			__core->SetDeviceProperty(streamName, MM::g_Keyword_StopBits, g_SerialStopBits);
+			__core->SetDeviceProperty(streamName, MM::g_Keyword_Handshaking, g_SerialHandshaking);
+			__core->SetDeviceProperty(streamName, MM::g_Keyword_AnswerTimeout, g_SerialAnswerTimeout);
+			__core->SetDeviceProperty(streamName, MM::g_Keyword_DelayBetweenCharsMs, g_SerialDelayBetweenCharsMs);
+			MM::Device* pS = __core->GetDevice(__target, streamName);
+			if (pS) {
+				pS->Initialize();
+			}
+			return pS;
+		}
+
+		/** Shut down a port opened with openStream() and restore its AnswerTimeout. */
+		static void closeStream(MM::Core* __core, MM::Device* __pS, const std::string& __stream, 
+				const std::string& __defaultAnswerTimeout) {
+			__pS->Shutdown();
+			// always restore the AnswerTimeout to the default
+			__core->SetDeviceProperty(__stream.c_str(), MM::g_Keyword_AnswerTimeout, __defaultAnswerTimeout.c_str());
+		}
+
+		/** Poll every open port until its slave sends PROT_READY, answers a
+		PROT_SYS_PING, or __timeoutMs expires. A slave that did not reset when the
+		port was opened answers the first PING, so only silent ports wait it out. */
+		static void waitForReady(MM::Core* __core, DEV* __target, const std::vector<std::string>& __streams,
+				const std::vector<MM::Device*>& __ports, std::vector<bool>& __ready, long __timeoutMs) {
+			size_t pending = 0;
+			for (MM::Device* pS : __ports) {
+				pending += pS ? 1 : 0;
+			}
+			// the slave's answer to PROT_SYS_PING, as dispatchTask() would read it
+			char pingReply[CODEC::INT_BUFF_SIZE + 1];
+			size_t pingReplyLen = CODEC::encodeInt(static_cast<prot_cmd_t>(PROT_SYS_PING), pingReply);
+			pingReply[pingReplyLen++] = PROT_TERM_CHAR;
+			const unsigned char ping = PROT_SYS_PING;
+			std::vector<std::string> received(__ports.size());
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			std::chrono::steady_clock::time_point deadline = now + std::chrono::milliseconds(__timeoutMs);
+			std::chrono::steady_clock::time_point nextPing = now;
+			while (pending > 0 && (now = std::chrono::steady_clock::now()) < deadline) {
+				bool pingNow = now >= nextPing;
+				if (pingNow) {
+					nextPing = now + std::chrono::milliseconds(g_SerialReadyPingMs);
+				}
+				for (size_t i = 0; i < __ports.size(); i++) {
+					if (!__ports[i] || __ready[i]) {
+						continue;
+					}
+					unsigned char buf[16];
+					unsigned long read = 0;
+					while (DEVICE_OK == __core->ReadFromSerial(__target, __streams[i].c_str(), buf, sizeof(buf), read) && read > 0) {
+						received[i].append(reinterpret_cast<const char*>(buf), read);
+						if (memchr(buf, PROT_READY, read) || received[i].find(pingReply, 0, pingReplyLen) != std::string::npos) {
+							__ready[i] = true;
+							pending--;
+							break;
+						}
+						if (received[i].length() > 2 * pingReplyLen) {
+							// only a reply split across reads needs the earlier bytes
+							received[i].erase(0, received[i].length() - pingReplyLen);
+						}
+					}
+					if (!__ready[i] && pingNow) {
+						__core->WriteToSerial(__target, __streams[i].c_str(), &ping, 1);
+					}
+				}
+				if (pending > 0) {
+					CDeviceUtils::SleepMs(g_SerialReadyPollMs);
+				}
+			}
+		}
+
 		/** Prevent simultaneous send/receive by guarding this lockStream */
 		MMThreadLock lock_;
 
+		int lockDepth_ = 0;			///< nesting depth of lockStream() calls
+		std::atomic<std::thread::id> lockOwner_{ std::thread::id() };	///< thread holding lock_
+		bool desync_ = false;		///< resync at the end of this transaction
+		bool resyncing_ = false;	///< resync() in progress
+		prot_ulong_t syncCount_ = 0;	///< nonce of the last PROT_SYNC
+
+		LatencyEstimate latency_[256];	///< answer latency of each command byte
+		bool adaptiveTimeouts_ = true;	///< use latency_ to set the answer timeout
+		bool timing_ = false;			///< is timingCmd_ being timed?
+		prot_cmd_t timingCmd_ = 0;		///< command being timed
+		std::chrono::steady_clock::time_point commandStart_;	///< when timingCmd_ was sent
+		std::chrono::steady_clock::time_point lastRead_;		///< last successful read
+		long maxTimeoutMs_ = 0;			///< the port's configured AnswerTimeout, 0 until read
+		long timeoutMs_ = 0;			///< AnswerTimeout currently set on the port
+
+		LinkHealth link_;				///< heartbeat results, guarded by lock_
+		std::atomic<unsigned> linkEpoch_{ 0 };	///< slave resets seen
+		std::atomic<std::chrono::steady_clock::rep> lastActivity_{ 0 };	///< end of the last transaction
+		std::chrono::steady_clock::time_point lastBeat_;	///< time of the last answered heartbeat
+		long heartbeatMs_ = g_HeartbeatIntervalMs;	///< idle time between heartbeats
+		long powerOnBaud_ = 0;			///< port baud rate before upgradeBaudRate()
+		long upgradedBaud_ = 0;			///< baud rate set by upgradeBaudRate(), 0 if not upgraded
+		std::atomic<bool> heartbeatRunning_{ false };
+		std::thread heartbeatThread_;
+		std::mutex heartbeatMutex_;
+		std::condition_variable heartbeatWake_;
+
 #ifdef LOG_DEVICE_HEX_PROTOCOL
-		std::stringstream protoLogStream_;	///< current logging stream
-		std::string lastProtoLog_;			///< string representation of last transaction
+		TransactionCapture<LOG_DEVICE_HEX_PROTOCOL_RECORDS> capture_;	///< binary transaction log
+		std::uint64_t transactionStart_ = 0;	///< capture sequence at the start of the transaction
+		AsyncLogSink<LOG_DEVICE_HEX_PROTOCOL_ASYNC_RECORDS> logSink_;	///< off-thread LogMessage forwarding
+		std::atomic<DEV*> logTarget_{ nullptr };	///< device the async log forwards to, null once it is stopped
+#endif
+
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+		TraceRecorder trace_;			///< trace spans
+		TraceEvent traceEvent_;			///< span of the current transaction
+		std::uint32_t traceCommands_ = 0;	///< commands sent in the current transaction
 #endif
 
 	};
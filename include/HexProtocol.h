@@ -240,6 +240,112 @@ A GET:SUB_VALUE()->(value) command from the host looks like this:
 			...check other SUB_CMD
 \endcode
 
+READY ANNOUNCEMENT
+=============================================================================
+
+Opening the serial port resets most Arduinos, which then spend a second or two
+in the bootloader before running the sketch. Rather than sleeping for a fixed
+time, the host waits for the slave to announce itself.
+
+\code
+	SLAVE calls announceReady() at the end of setup(), which sends
+		byte:PROT_READY [EOT]
+	HOST tryStream() polls the freshly opened port until it sees PROT_READY
+		or an answer to the PROT_SYS_PING it keeps sending while it waits,
+		so boards that do not reset on open are found at once
+\endcode
+
+PROT_READY is a control character, so it can never be confused with a 
+HEX-encoded value.
+
+SYSTEM COMMANDS
+=============================================================================
+
+Command bytes in the ASCII control range from PROT_SYS_FIRST to PROT_SYS_LAST
+are reserved for the protocol itself. processCommand() hands them to 
+processSystemCommand() before the DEV command function ever sees them, so
+application firmware should only use printable command bytes.
+
+| command        | signature                          | purpose                          |
+|----------------|------------------------------------|----------------------------------|
+| PROT_SYS_PING  | PING() -> ()                       | is the slave listening?          |
+| PROT_SYS_BAUD  | BAUD(newBaud, oldBaud) -> ()       | switch to a faster baud rate     |
+| PROT_SYS_CAPS  | CAPS(version, encodings, families, rxBufferSize) -> (version, encodings, families, rxBufferSize) | capability exchange |
+| PROT_SYS_HEARTBEAT | HEARTBEAT() -> (uptimeMs)      | link liveness and slave uptime   |
+| PROT_SYNC      | SYNC(nonce) -> (SYNC nonce)        | force the slave parser back to idle |
+
+Resynchronization
+-----------------------------------------------------------------------------
+
+If a token is lost the host and slave disagree about where they are in a
+command. The host recovers in one round trip by sending the PROT_SYNC
+escape followed by a HEX nonce:
+
+\code
+	HOST sends byte:PROT_SYNC HEX:nonce[EOT]
+	SLAVE, if idle, receives PROT_SYNC as a command.
+	SLAVE, if waiting for a value, finds PROT_SYNC inside the token it read,
+		fails the current command, and replyError() sends the sync reply 
+		instead of PROT_ERROR.
+	SLAVE sends byte:PROT_SYNC nonce[EOT] and is idle again
+	HOST discards every token up to the sync reply with its nonce
+\endcode
+
+PROT_SYNC must therefore never appear inside a string value. Slaves report
+CAP_FAM_SYNC in their capabilities; the host purges the port instead when
+talking to older slaves.
+
+Capabilities
+-----------------------------------------------------------------------------
+
+Rather than matching compile-time \c \#defines on both sides, the host sends
+its ProtocolCaps to the slave once per session and the slave answers with its
+own. Each side intersects the encodings and command families and caches them
+in HexProtocolBase::caps(), so dispatch code can pick the fastest mechanism 
+both sides support. A slave that does not understand PROT_SYS_CAPS replies 
+with PROT_ERROR and is treated as protocol version 0 with only the 
+compile-time encodings. The host only sends PROT_SYS_CAPS after a slave has
+answered PROT_SYS_PING, so older firmware never sees the arguments. A slave 
+goes back to the legacyCaps() whenever it calls announceReady().
+
+Baud rate upgrade
+-----------------------------------------------------------------------------
+
+\code
+	HOST calls dispatchSet(PROT_SYS_BAUD, newBaud, oldBaud)
+	SLAVE replies, waits for the reply to leave, then switches to newBaud
+	HOST switches its port to newBaud and sends PROT_SYS_PING
+	SLAVE treats the first PING as confirmation. Without one within 
+		PROT_BAUD_VERIFY_MS it switches back to oldBaud
+	HOST falls back to oldBaud if the PING fails
+\endcode
+
+Static dispatch of the low-level I/O
+-----------------------------------------------------------------------------
+
+By default, writeByte(), readBufferUntilTerminator() and the other 
+low-level I/O functions are virtual, so every byte goes through a vtable,
+and on the AVR the vtables live in RAM. With \c \#define PROT_STATIC_DISPATCH
+before the first \c \#include "HexProtocol.h", these functions are no longer
+virtual. HexProtocolBase reaches them through io(), which casts to DEV, so
+each call is resolved at compile time and can be inlined into the dispatchXXX
+and processXXX functions.
+
+The same goes for the hooks a driver or DEV may replace: startProtocol(),
+endProtocol(), hasStarted(), localCaps(), processSystemCommand(),
+noteCommand(), noteChannel(), noteDesync() and the destructor, and on the
+slave maxBaudRate() and changeBaudRate(). With all of them resolved through
+DEV, StreamHexProtocol needs no vtable at all, which saves the vtable in RAM
+and a vtable pointer in every protocol object on the AVR. The destructor is
+not virtual either, so never delete a DEV through a pointer to the driver.
+
+Static dispatch needs DEV to derive from the driver class, which is how
+StreamHexProtocol and DeviceHexProtocol are normally used, and a driver must
+declare HexProtocolBase a friend. A DEV that overrides one of these
+functions hides the driver's version instead of overriding it, so the
+override must be declared in DEV itself, with PROT_IO_OVERRIDE in place of
+\c override.
+
 Passing Values through the protocol
 =============================================================================
 
@@ -253,6 +359,22 @@ and receive float's (32-bits) as IEEE-754 hex numbers, but NOT double's (64-bits
 With that said, double's on the AVR are generally 32-bit, NOT 64-bit. So on the Arduino,
 sizeof(double) == sizeof(float). So, we should stick with floats for transmitting.
 
+64-bit integers and doubles
+-----------------------------------------------------------------------------
+
+Values up to 32 bits still use 32-bit arithmetic. 64-bit integers 
+(prot_llong_t, prot_ullong_t, or any 8-byte integer type) are sent in one 
+token when both sides report CAP_ENC_INT64, using the protocol's own 
+prot_ulltohexstr() and prot_hexstrtoull() rather than the libc. Doubles are 
+sent as their 64-bit IEEE-754 bits when both sides report CAP_ENC_DOUBLE,
+which a slave only does if its doubles really are 64 bits.
+
+The host adapts to the slave. Against a slave without CAP_ENC_INT64 it sends
+a 64-bit value only if it fits in 32 bits and fails otherwise, and it narrows
+doubles to floats as before. A slave uses its 64-bit encodings once the host 
+has asked for its capabilities. Slaves short on flash may \c \#define 
+PROT_NO_INT64 to leave the 64-bit code out altogether.
+
 NOTES on IEEE-754 floating point values
 -----------------------------------------------------------------------------
 
@@ -268,6 +390,28 @@ are sufficient to represent 32-bit floats (23 bits of mantissa). So, for
 a full floating point representation with 7 places of precision, we need
 a buffer to hold -X.1234567e+XXX or 3 + 7 + 5 = 15 characters
 
+Choosing a value codec
+-----------------------------------------------------------------------------
+
+The HEX text above is only the default. The CODEC template parameter of 
+HexProtocolBase, StreamHexProtocol and DeviceHexProtocol selects how values 
+are encoded, for example
+
+\code{.cpp}
+	class MyHandler : public StreamHexProtocol<MyHandler, VarintCodec> { ... };
+	class MyDevice : public CGenericBase<MyDevice>, public DeviceHexProtocol<MyDevice, VarintCodec> { ... };
+\endcode
+
+VarintCodec is usually the shortest. A channel, sub-command or array index
+takes one byte plus [EOT] instead of up to three HEX characters, and a small
+negative value takes one byte instead of a '-' and HEX digits. BinaryCodec 
+sends every integer in 5 bytes but decodes in constant time.
+
+A pair that does not name a codec uses PROT_CODEC, which is HexCodec unless
+it is \c \#defined before the first \c \#include "HexProtocol.h". RemoteProp
+talks to its hub as DeviceHexProtocol<HUB>, so a hub with remote properties
+changes its codec through PROT_CODEC. @see AboutCodecs
+
 Calling member functions through dispatchXXX methods
 ==============================================
 
@@ -414,6 +558,7 @@ if every command chain is enclosed in a test clause.
 #include <Arduino.h>
 #include <stdint.h>
 #include <stdio.h> // for size_t
+#include <float.h>
 /** The avr (Arduino) libray defines standard integer types uint8_t, etc
 without namespace std, so we define std as blank here to use the global
 address space ::uint8_t, etc on the avr side */
@@ -423,6 +568,11 @@ address space ::uint8_t, etc on the avr side */
 
 
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <string>
 #endif // #ifdef __AVR__
 
 
@@ -448,6 +598,10 @@ namespace hprot {
 	typedef std::int32_t prot_long_t;
 	/** The maximum type of unsigned integer */
 	typedef std::uint32_t prot_ulong_t;
+	/** 64-bit signed integer, passed natively when both sides support CAP_ENC_INT64 */
+	typedef std::int64_t prot_llong_t;
+	/** 64-bit unsigned integer, passed natively when both sides support CAP_ENC_INT64 */
+	typedef std::uint64_t prot_ullong_t;
 	/** Standard floating-point type */
 	typedef float prot_float_t;
 	/** standard size_t type *only* used for passing buffer sizes back and forth. Internal
@@ -465,6 +619,14 @@ namespace hprot {
 	typedef std::string prot_string_t;
 #endif // #ifdef __AVR__
 
+	/** Features of one side of the protocol, exchanged with PROT_SYS_CAPS. */
+	struct ProtocolCaps {
+		prot_ulong_t version;			///< PROT_VERSION
+		prot_ulong_t encodings;			///< CapEncodings bits
+		prot_ulong_t families;			///< CapFamilies bits
+		prot_size_t rxBufferSize;		///< receive buffer size in bytes, 0 if unknown
+	};
+
 
 
 	///@}
@@ -479,12 +641,64 @@ namespace hprot {
 
 #define PROT_ERROR				ASCII_NAK					///< protocol error command
 #define PROT_TERM_CHAR			ASCII_EOT					///< all transmissions end in an ASCII EOT character
+#define PROT_READY				ASCII_DC1					///< sent by the slave once it has booted
+
+#define PROT_SYS_FIRST			ASCII_DC1					///< first reserved system command
+#define PROT_SYS_BAUD			ASCII_DC2					///< BAUD(newBaud, oldBaud)->() baud rate upgrade
+#define PROT_SYS_CAPS			ASCII_DC3					///< CAPS(ProtocolCaps)->(ProtocolCaps) capability exchange
+#define PROT_SYS_HEARTBEAT		ASCII_DC4					///< HEARTBEAT()->(uptimeMs) link liveness and slave uptime
+#define PROT_SYS_PING			ASCII_SYN					///< PING()->() is the slave listening?
+#define PROT_SYNC				ASCII_CAN					///< SYNC(nonce)->(SYNC nonce) escape that returns the slave parser to idle
+#define PROT_SYS_LAST			ASCII_CAN					///< last reserved system command
+#define PROT_BAUD_VERIFY_MS		1000						///< slave reverts a baud change without a PING in this time
 #define PROT_RADIX				16							///< transmit HEX characters
 #define IS_SIGNED(TYPE)			((TYPE)(-1)<(TYPE)(0))		///< Helper macro to test if a type supports signed values
 
+#ifdef PROT_STATIC_DISPATCH
+#define PROT_IO_VIRTUAL										///< low-level I/O functions are resolved at compile time through DEV
+#define PROT_IO_OVERRIDE									///< drivers hide the low-level I/O functions instead of overriding them
+#else
+#define PROT_IO_VIRTUAL			virtual						///< low-level I/O functions are virtual
+#define PROT_IO_OVERRIDE		override					///< drivers override the low-level I/O functions
+#endif
+
+	/** Protocol version reported in ProtocolCaps. Slaves that predate the capability exchange are version 0. */
+	const prot_ulong_t PROT_VERSION = 1;
+
+	/** ProtocolCaps::encodings bits */
+	enum CapEncodings {
+		CAP_ENC_HEX = 0x0001,			///< HEX text values, always supported
+		CAP_ENC_IEEE754 = 0x0002,		///< floats passed as IEEE-754 bit patterns (PROT_FLOAT_IEEE754)
+		CAP_ENC_BINARY = 0x0004,		///< integers passed as fixed-width 7-bit groups (BinaryCodec)
+		CAP_ENC_VARINT = 0x0008,		///< integers passed as zigzag varints (VarintCodec)
+		CAP_ENC_INT64 = 0x0010,			///< 64-bit integers passed natively (unless PROT_NO_INT64)
+		CAP_ENC_DOUBLE = 0x0020,		///< 64-bit doubles passed as IEEE-754 bit patterns
+	};
+
+	/** ProtocolCaps::families bits for optional command families */
+	enum CapFamilies {
+		CAP_FAM_BAUD = 0x0001,			///< PROT_SYS_BAUD upgrades
+		CAP_FAM_SYNC = 0x0002,			///< PROT_SYNC resynchronization
+		CAP_FAM_HEARTBEAT = 0x0004,		///< PROT_SYS_HEARTBEAT with slave uptime
+		CAP_FAM_PACKED_ARRAY = 0x0008,	///< SUBCMD_ARRAY_FORMAT packed float array elements
+		CAP_FAM_ARRAY_RUN = 0x0010,		///< SUBCMD_ARRAY_RUN runs of array elements
+		CAP_FAM_SEQ_GENERATOR = 0x0020,	///< SUBCMD_SEQ_RAMP and SUBCMD_SEQ_REPEAT sequence generators
+	};
+
 	/** Maximum integer hex digits in protocol. Add 2 bytes for possible negative sign and null term. */
 	const size_t PROT_HEX_BUFF_SIZE = (2 * sizeof(prot_ulong_t) + 2);
 
+	/** Maximum 64-bit integer hex digits in protocol. Add 2 bytes for possible negative sign and null term. */
+	const size_t PROT_LLONG_HEX_BUFF_SIZE = (2 * sizeof(prot_ullong_t) + 2);
+
+#ifdef PROT_NO_INT64
+	/** Largest integer getValue() and putValue() accept. \c \#define PROT_NO_INT64 to leave out 64-bit values. */
+	const size_t PROT_INT_MAX_SIZE = sizeof(prot_ulong_t);
+#else
+	/** Largest integer getValue() and putValue() accept. \c \#define PROT_NO_INT64 to leave out 64-bit values. */
+	const size_t PROT_INT_MAX_SIZE = sizeof(prot_ullong_t);
+#endif
+
 	///@}
 	//////////////////////////////////////////////////////////////////////////
 
@@ -583,12 +797,33 @@ inline double prot_strtof(const char* __str) {
 			__buf[0] = '\0';
 			return __buf;
 		}
+#ifdef _MSC_VER
 		return _ltoa(__val, __buf, PROT_RADIX);
+#else
+		// like _ltoa, a negative value prints as its 32-bit two's complement
+		snprintf(__buf, __size, "%lx", static_cast<unsigned long>(static_cast<prot_ulong_t>(__val)));
+		return __buf;
+#endif
 	}
 
 	/** helper to convert unsigned longs to text. Uses stdlib version of ultoa. The __size must be >= PROT_HEX_BUFF_SIZE. */
 	inline char* prot_ultohexstr(unsigned long __val, char* __str, int __base) {
+#ifdef _MSC_VER
 		return _ultoa(__val, __str, __base);
+#else
+		// _ultoa is only in the Microsoft runtime
+		char digits[8 * sizeof(unsigned long)];
+		size_t n = 0;
+		do {
+			digits[n++] = "0123456789abcdefghijklmnopqrstuvwxyz"[__val % __base];
+			__val /= __base;
+		} while (__val);
+		for (size_t i = 0; i < n; i++) {
+			__str[i] = digits[n - 1 - i];
+		}
+		__str[n] = '\0';
+		return __str;
+#endif
 	}
 
 #ifndef PROT_FLOAT_IEEE754
@@ -603,7 +838,11 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		__prec = PROT_FLOAT_MAX_PREC;
 	}
 	// use sprintf to mimic the dtostre function of the AVR library
+#ifdef _MSC_VER
 	sprintf_s(__buf, __size, "%.*e", __prec, __val);
+#else
+	snprintf(__buf, __size, "%.*e", __prec, __val);
+#endif
 	return __buf;
 }
 #endif // #ifdef PROT_FLOAT_IEEE754
@@ -615,6 +854,50 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 
 #endif // #ifdef __AVR__
 
+	//////////////////////////////////////////////////////////////
+	/// \name 64-bit integers to/from strings
+	/// \ingroup	HexProtocol 
+	/// The AVR libc has no 64-bit ultoa or strtoull, so both sides use these.
+	///@{
+
+	/** Helper to convert 64-bit unsigned integers to HEX text. The __buf must hold PROT_LLONG_HEX_BUFF_SIZE bytes. */
+	inline char* prot_ulltohexstr(prot_ullong_t __val, char* __buf) {
+		char digits[2 * sizeof(prot_ullong_t)];
+		size_t len = 0;
+		do {
+			unsigned d = static_cast<unsigned>(__val & 0xF);
+			digits[len++] = static_cast<char>(d < 10 ? '0' + d : 'a' + d - 10);
+			__val >>= 4;
+		} while (__val);
+		for (size_t i = 0; i < len; i++) {
+			__buf[i] = digits[len - 1 - i];
+		}
+		__buf[len] = '\0';
+		return __buf;
+	}
+
+	/** Helper to convert HEX text to a 64-bit unsigned integer. Stops at the first character that is not a HEX digit. */
+	inline prot_ullong_t prot_hexstrtoull(const char* __str) {
+		prot_ullong_t val = 0;
+		for (;; __str++) {
+			char c = *__str;
+			unsigned d;
+			if (c >= '0' && c <= '9') {
+				d = c - '0';
+			} else if (c >= 'a' && c <= 'f') {
+				d = c - 'a' + 10;
+			} else if (c >= 'A' && c <= 'F') {
+				d = c - 'A' + 10;
+			} else {
+				return val;
+			}
+			val = (val << 4) | d;
+		}
+	}
+
+	///@}
+	//////////////////////////////////////////////////////////////
+
 
 
 	/**
@@ -645,6 +928,61 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 	GET_SEQ		| SUBCMD_ARRAY_ELEMENT	| (index)->(el)	| retrieves an alement from a given index location
 	\b SET_SEQ	| SUBCMD_ARRAY_FINISHED	| (length)->()	| sets the final length of the array. The receiver may perform some action too
 	GET_SEQ		| SUBCMD_ARRAY_FINISHED	| ---			| **is not used**
+	\b SET_SEQ	| SUBCMD_ARRAY_FORMAT	| (format[,scale,offset])->() | packs the following elements (see ArrayFormat)
+	GET_SEQ		| SUBCMD_ARRAY_FORMAT	| ---			| **is not used**
+	\b SET_SEQ	| SUBCMD_ARRAY_RUN		| (index,count,first,step)->() | sets count elements first + k * step from index
+	GET_SEQ		| SUBCMD_ARRAY_RUN		| ---			| **is not used**
+	\b SET_SEQ	| SUBCMD_SEQ_RAMP		| (start,step,count)->() | appends a ramp to a sequence generator
+	\b SET_SEQ	| SUBCMD_SEQ_REPEAT		| (block,times)->() | plays the last block instructions times in all
+
+	Packed float arrays
+	---------------------------------------
+
+	Float sequences can be sent in fewer bytes when the slave advertises 
+	CAP_FAM_PACKED_ARRAY. After SUBCMD_ARRAY_SIZE the host sends SUBCMD_ARRAY_FORMAT
+	and every SUBCMD_ARRAY_ELEMENT that follows carries a packed integer instead of
+	a prot_float_t:
+
+	format				| element sent as			| slave expands to
+	--------------------|---------------------------|--------------------------
+	ARRAY_FORMAT_NATIVE	| prot_float_t				| the value
+	ARRAY_FORMAT_HALF	| IEEE-754 half bits		| prot_halftof(bits)
+	ARRAY_FORMAT_FIXED	| prot_long_t steps			| offset + steps * scale
+
+	The slave refuses a format for arrays that are not float or double, and 
+	the format is forgotten at the next SUBCMD_ARRAY_SIZE or SUBCMD_ARRAY_FINISHED.
+
+	Array runs
+	---------------------------------------
+
+	Sequences are mostly ramps and repeated values. When the slave advertises
+	CAP_FAM_ARRAY_RUN the host looks for arithmetic runs of at least 
+	PROT_ARRAY_MIN_RUN elements and sends each one as a single SUBCMD_ARRAY_RUN.
+	A repeated value is a run with a zero step. Run values are always sent as 
+	plain values, never packed. @see ProtArrayRun
+
+	Sequence generators
+	---------------------------------------
+
+	A slave that keeps a sequence as a ProtSequence program instead of an 
+	array handles its SET_SEQ command with processSetSequence(). The host then
+	uploads instructions rather than values:
+
+	\code{.cpp}
+		put(SET, SUBCMD_ARRAY_SIZE)			// starts a new program
+		getValue(maxInstructions)
+		put(SET, SUBCMD_SEQ_RAMP)			// for each instruction
+		putValue(start), putValue(step), putValue(count)
+		put(SET, SUBCMD_SEQ_REPEAT)
+		putValue(block), putValue(times)
+		put(SET, SUBCMD_ARRAY_FINISHED)
+		putValue(numInstructions)
+	\endcode
+
+	Instructions play one after the other, so concatenation needs no instruction
+	of its own. Upload cost depends on the program, not on the number of values,
+	and ramp counts are prot_ulong_t so a sequence may outgrow prot_size_t.
+	Slaves advertise CAP_FAM_SEQ_GENERATOR.
 
 	In the template definitions below, D is the class (ie FooClass) of the member
 	function we want to	invoke and __target is the class instance pointer
@@ -660,18 +998,789 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 	const prot_cmd_t SUBCMD_ARRAY_STARTING = 0x02; ///< GET subcommand () tells that we are about to receive the array
 	const prot_cmd_t SUBCMD_ARRAY_ELEMENT = 0x03; ///< GET/SET subcommand (index, element) sets or gets an array element
 	const prot_cmd_t SUBCMD_ARRAY_FINISHED = 0x04; ///< SET subcommand (length) finishes set or get and sets the total number of elements
+	const prot_cmd_t SUBCMD_ARRAY_FORMAT = 0x05; ///< SET subcommand (format[, scale, offset]) packs the elements that follow
+	const prot_cmd_t SUBCMD_ARRAY_RUN = 0x06; ///< SET subcommand (index, count, first, step) sets a run of array elements
+	const prot_cmd_t SUBCMD_SEQ_RAMP = 0x07; ///< SET subcommand (start, step, count) appends a ramp to a sequence generator
+	const prot_cmd_t SUBCMD_SEQ_REPEAT = 0x08; ///< SET subcommand (block, times) repeats the last block generator instructions
+
+	///@}
+	//////////////////////////////////////////////////////////////////////////
+
+	//////////////////////////////////////////////////////////////////////////
+	/// \name Packed float array elements
+	/// \ingroup	HexProtocol 
+	///@{
+
+	/** IEEE-754 half-precision bits */
+	typedef std::uint16_t prot_half_t;
+
+	/** SUBCMD_ARRAY_FORMAT element formats */
+	enum ArrayFormat {
+		ARRAY_FORMAT_NATIVE = 0,		///< elements sent as prot_float_t
+		ARRAY_FORMAT_HALF = 1,			///< elements sent as prot_half_t, about 3 significant digits
+		ARRAY_FORMAT_FIXED = 2,			///< elements sent as prot_long_t steps of scale above offset
+	};
+
+	/** Helper to round a float to the nearest IEEE-754 half. Overflows to infinity. */
+	inline prot_half_t prot_ftohalf(prot_float_t __val) {
+		// memcpy rather than a pointer cast, which breaks strict aliasing
+		prot_ulong_t bits;
+		memcpy(&bits, &__val, sizeof(bits));
+		prot_half_t sign = static_cast<prot_half_t>((bits >> 16) & 0x8000);
+		prot_long_t exp = static_cast<prot_long_t>((bits >> 23) & 0xFF) - 127 + 15;
+		prot_ulong_t mant = bits & 0x7FFFFF;
+		if (exp == 0xFF - 127 + 15) {
+			// infinity stays infinity, NaN keeps a mantissa bit
+			return sign | 0x7C00 | (mant ? 0x200 : 0);
+		}
+		if (exp >= 0x1F) {
+			return sign | 0x7C00;
+		}
+		if (exp <= 0) {
+			// subnormal half or zero
+			if (exp < -10) {
+				return sign;
+			}
+			mant |= 0x800000;
+			int shift = static_cast<int>(14 - exp);
+			prot_ulong_t half = mant >> shift;
+			prot_ulong_t rest = mant & ((1UL << shift) - 1);
+			prot_ulong_t mid = 1UL << (shift - 1);
+			if (rest > mid || (rest == mid && (half & 1))) {
+				half++;
+			}
+			return sign | static_cast<prot_half_t>(half);
+		}
+		// round to nearest even. A mantissa carry rolls into the exponent.
+		prot_ulong_t half = (static_cast<prot_ulong_t>(exp) << 10) | (mant >> 13);
+		prot_ulong_t rest = mant & 0x1FFF;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+			half++;
+		}
+		return sign | static_cast<prot_half_t>(half);
+	}
+
+	/** Helper to expand an IEEE-754 half to a float. Exact. */
+	inline prot_float_t prot_halftof(prot_half_t __half) {
+		prot_ulong_t sign = static_cast<prot_ulong_t>(__half & 0x8000) << 16;
+		prot_ulong_t exp = (__half >> 10) & 0x1F;
+		prot_ulong_t mant = __half & 0x3FF;
+		prot_ulong_t bits;
+		if (exp == 0x1F) {
+			bits = sign | 0x7F800000 | (mant << 13);
+		} else if (exp != 0) {
+			bits = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+		} else if (mant == 0) {
+			bits = sign;
+		} else {
+			// normalize the subnormal half
+			exp = 127 - 15 + 1;
+			while (!(mant & 0x400)) {
+				mant <<= 1;
+				exp--;
+			}
+			bits = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+		}
+		prot_float_t val;
+		memcpy(&val, &bits, sizeof(val));
+		return val;
+	}
+
+	/** How the elements of a float array are packed, the arguments of SUBCMD_ARRAY_FORMAT. */
+	struct ArrayPacking {
+		prot_byte_t format;				///< ArrayFormat
+		prot_float_t scale;				///< ARRAY_FORMAT_FIXED value of one step
+		prot_float_t offset;			///< ARRAY_FORMAT_FIXED value of step zero
+
+		ArrayPacking() : format(ARRAY_FORMAT_NATIVE), scale(1), offset(0) {}
+
+		/** Pack elements as IEEE-754 halves */
+		static ArrayPacking half() {
+			ArrayPacking packing;
+			packing.format = ARRAY_FORMAT_HALF;
+			return packing;
+		}
+
+		/** Pack elements as __bits-bit steps from __min to __max. Values outside are not clamped.
+		__bits is limited to 1..31, since the steps are sent as prot_long_t. */
+		static ArrayPacking fixed(prot_float_t __min, prot_float_t __max, int __bits) {
+			__bits = __bits < 1 ? 1 : (__bits > 31 ? 31 : __bits);
+			ArrayPacking packing;
+			packing.format = ARRAY_FORMAT_FIXED;
+			packing.scale = (__max - __min) / static_cast<prot_float_t>((1UL << __bits) - 1);
+			packing.offset = __min;
+			return packing;
+		}
+
+		/** Round a value to the nearest ARRAY_FORMAT_FIXED step */
+		prot_long_t toSteps(prot_float_t __val) const {
+			if (scale == 0) {
+				return 0;
+			}
+			prot_float_t steps = (__val - offset) / scale;
+			steps = steps < 0 ? steps - 0.5f : steps + 0.5f;
+			// converting an out of range float is undefined, so saturate. NaN fails both tests
+			if (!(steps < 2147483648.0f)) {
+				return steps == steps ? 0x7FFFFFFFL : 0;
+			}
+			if (!(steps > -2147483648.0f)) {
+				return -0x7FFFFFFFL - 1;
+			}
+			return static_cast<prot_long_t>(steps);
+		}
+
+		/** Expand ARRAY_FORMAT_FIXED steps back to a value */
+		prot_float_t fromSteps(prot_long_t __steps) const {
+			return offset + scale * static_cast<prot_float_t>(__steps);
+		}
+	};
 
 	///@}
 	//////////////////////////////////////////////////////////////////////////
 
-	// Compile-time checks on the value sizes
-	static_assert(sizeof(prot_long_t) == sizeof(long), "sizeof(prot_long_t) != sizeof(long)");
-	static_assert(sizeof(prot_ulong_t) == sizeof(long), "sizeof(prot_ulong_t) != sizeof(long)");
+	// Compile-time checks on the value sizes. The long helpers above take every
+	// prot_long_t. long is 32 bits on the AVR and Windows, 64 on Linux and macOS.
+	static_assert(sizeof(prot_long_t) <= sizeof(long), "sizeof(prot_long_t) > sizeof(long)");
+	static_assert(sizeof(prot_ulong_t) <= sizeof(long), "sizeof(prot_ulong_t) > sizeof(long)");
+
+#ifdef PROT_FLOAT_IEEE754
+	static_assert(sizeof(prot_float_t) == sizeof(prot_ulong_t), "sizeof(prot_float_t) != sizeof(prot_ulong_t)");
+#endif // #ifdef PROT_FLOAT_IEEE754
+
+
+	/**
+	\ingroup HexProtocol
+
+	\page AboutCodecs	About Value Codecs
+
+	Value Codecs
+	=======================================
+
+	The codec is the CODEC template parameter of HexProtocolBase. It turns
+	integers and floats into the bytes of a single [EOT] terminated token and 
+	back. Strings and commands are never encoded. A codec is a structure of 
+	static members, so the choice is made at compile time:
+
+	member								| meaning
+	------------------------------------|---------------------------------------------
+	INT_BUFF_SIZE						| buffer size for an encoded integer, with room for a terminator
+	LLONG_BUFF_SIZE						| buffer size for an encoded 64-bit integer, with room for a terminator
+	FLOAT_BUFF_SIZE						| buffer size for an encoded float, with room for a terminator
+	encodings()							| CapEncodings bits this codec puts on the wire
+	encodeInt(val, buf)					| encode an integer of up to 64 bits into buf and return its length
+	decodeInt(buf, len, val)			| decode len bytes, null terminated at buf[len]
+	encodeFloat(val, buf)				| encode a prot_float_t into buf and return its length
+	decodeFloat(buf, len, val)			| decode len bytes, null terminated at buf[len]
+
+	Encoded tokens must never contain PROT_TERM_CHAR or PROT_SYNC. The host and
+	the slave must use the same codec.
+	*/
+
+	//////////////////////////////////////////////////////////////////////////
+	/// \name Value codecs
+	/// \ingroup	HexProtocol 
+	///@{
+
+	/** The unsigned and signed words an integer of type T is encoded through.
+	Values up to 32 bits never touch 64-bit arithmetic, which is slow on the AVR. */
+	template <typename T, bool WIDE = (sizeof(T) > sizeof(prot_ulong_t))>
+	struct ProtWord {
+		typedef prot_ulong_t utype;
+		typedef prot_long_t stype;
+	};
 
+	/** 64-bit words. */
+	template <typename T>
+	struct ProtWord<T, true> {
+		typedef prot_ullong_t utype;
+		typedef prot_llong_t stype;
+	};
+
+	/** HEX text codec. Integers are sent as HEX digits, with a leading '-'
+	for negative signed values. Floats are sent as the HEX digits of their
+	IEEE-754 bits, or as text if PROT_FLOAT_IEEE754 is undefined. */
+	struct HexCodec {
+		/** One more than the longest token, so a reader that stops at the buffer 
+		size still consumes the terminator of a negative full-width value. */
+		static const size_t INT_BUFF_SIZE = PROT_HEX_BUFF_SIZE + 1;
+		static const size_t LLONG_BUFF_SIZE = PROT_LLONG_HEX_BUFF_SIZE + 1;
+		static const size_t FLOAT_BUFF_SIZE = PROT_FLOAT_BUFF_SIZE;
+
+		static prot_ulong_t encodings() {
 #ifdef PROT_FLOAT_IEEE754
-	static_assert(sizeof(prot_float_t) == sizeof(long), "sizeof(prot_float_t) != sizeof(long)");
+			return CAP_ENC_HEX | CAP_ENC_IEEE754;
+#else
+			return CAP_ENC_HEX;
+#endif
+		}
+
+		template <typename T>
+		static size_t encodeInt(T __val, char* __buf) {
+			static_assert(sizeof(T) <= sizeof(prot_ullong_t), "encodeInt does not work for this type");
+			typedef typename ProtWord<T>::utype U;
+			typedef typename ProtWord<T>::stype L;
+			if (
+				IS_SIGNED(T)) {
+				L temp = static_cast<L>(__val);
+				if (temp < 0) {
+					/** HEX transfer of negative does not work well.
+					We will handle negatives ourselves */
+					__buf[0] = '-';
+					// negate as unsigned, which also works for the most negative value
+					toHex(static_cast<U>(U(0) - static_cast<U>(temp)), __buf + 1);
+				} else {
+					toHex(static_cast<U>(temp), __buf);
+				}
+			} else {
+				toHex(static_cast<U>(__val), __buf);
+			}
+			return strlen(__buf);
+		}
+
+		template <typename T>
+		static bool decodeInt(const char* __buf, size_t, T& __val) {
+			static_assert(sizeof(T) <= sizeof(prot_ullong_t), "decodeInt does not work for this type");
+			typedef typename ProtWord<T>::utype U;
+			typedef typename ProtWord<T>::stype L;
+			U temp;
+			if (
+				IS_SIGNED(T)) {
+				/** HEX transfer of negative does not work well.
+				We will handle negatives ourselves */
+				const char* negSign = strchr(__buf, '-');
+				if (negSign) {
+					fromHex(negSign + 1, temp);
+					__val = static_cast<T>(static_cast<L>(U(0) - temp));
+					return true;
+				}
+			}
+			fromHex(__buf, temp);
+			__val = static_cast<T>(temp);
+			return true;
+		}
+
+		static size_t encodeFloat(prot_float_t __val, char* __buf) {
+#ifdef PROT_FLOAT_IEEE754
+			/** The BIG assumption is that floats are IEEE-754 on both sides of the transfer. */
+			prot_ulong_t bits;
+			memcpy(&bits, &__val, sizeof(bits));
+			return encodeInt(bits, __buf);
+#else // NOT #ifdef PROT_FLOAT_IEEE754
+			prot_ftostr(__val, __buf, FLOAT_BUFF_SIZE, PROT_FLOAT_MAX_PREC);
+			return strlen(__buf);
+#endif // #ifdef PROT_FLOAT_IEEE754
+		}
+
+		static bool decodeFloat(const char* __buf, size_t __len, prot_float_t& __val) {
+#ifdef PROT_FLOAT_IEEE754
+			prot_ulong_t temp;
+			if (!decodeInt(__buf, __len, temp)) {
+				return false;
+			}
+			memcpy(&__val, &temp, sizeof(__val));
+			return true;
+#else // NOT #ifdef PROT_FLOAT_IEEE754
+			__val = static_cast<prot_float_t>(prot_strtof(__buf));
+			return true;
 #endif // #ifdef PROT_FLOAT_IEEE754
+		}
+
+	protected:
+		static void toHex(prot_ulong_t __val, char* __buf) {
+			prot_ultohexstr(__val, __buf, PROT_RADIX);
+		}
+
+		static void toHex(prot_ullong_t __val, char* __buf) {
+			prot_ulltohexstr(__val, __buf);
+		}
+
+		static void fromHex(const char* __buf, prot_ulong_t& __val) {
+			__val = strtoul(__buf, nullptr, PROT_RADIX);
+		}
+
+		static void fromHex(const char* __buf, prot_ullong_t& __val) {
+			__val = prot_hexstrtoull(__buf);
+		}
+	};
+
+	/** Compact binary codec. Every integer is sent as the full width of a
+	prot_ulong_t in 7-bit groups, most significant first, each with the high
+	bit set so no byte can be mistaken for a control character. That is 5
+	bytes for 32 bits instead of up to 9 HEX characters, and decoding needs
+	neither strtoul nor a sign. 64-bit integers take 10 bytes. Floats are 
+	always sent as their IEEE-754 bits. */
+	struct BinaryCodec {
+		static const size_t INT_BYTES = (8 * sizeof(prot_ulong_t) + 6) / 7;
+		static const size_t LLONG_BYTES = (8 * sizeof(prot_ullong_t) + 6) / 7;
+		/** Room for the terminator as well as the null, so a reader that stops
+		at the buffer size still consumes the terminator of a full token. */
+		static const size_t INT_BUFF_SIZE = INT_BYTES + 2;
+		static const size_t LLONG_BUFF_SIZE = LLONG_BYTES + 2;
+		static const size_t FLOAT_BUFF_SIZE = INT_BUFF_SIZE;
+
+		static prot_ulong_t encodings() {
+			return CAP_ENC_BINARY | CAP_ENC_IEEE754;
+		}
+
+		template <typename T>
+		static size_t encodeInt(T __val, char* __buf) {
+			static_assert(sizeof(T) <= sizeof(prot_ullong_t), "encodeInt does not work for this type");
+			typedef typename ProtWord<T>::utype U;
+			const size_t bytes = (8 * sizeof(U) + 6) / 7;
+			// signed values are sign-extended to the full width
+			U temp = static_cast<U>(__val);
+			for (size_t i = bytes; i > 0; i--) {
+				__buf[i - 1] = static_cast<char>(0x80 | (temp & 0x7F));
+				temp >>= 7;
+			}
+			return bytes;
+		}
 
+		template <typename T>
+		static bool decodeInt(const char* __buf, size_t __len, T& __val) {
+			static_assert(sizeof(T) <= sizeof(prot_ullong_t), "decodeInt does not work for this type");
+			typedef typename ProtWord<T>::utype U;
+			const size_t bytes = (8 * sizeof(U) + 6) / 7;
+			if (__len != bytes) {
+				return false;
+			}
+			U temp = 0;
+			for (size_t i = 0; i < bytes; i++) {
+				prot_byte_t b = static_cast<prot_byte_t>(__buf[i]);
+				if (!(b & 0x80)) {
+					return false;
+				}
+				temp = (temp << 7) | (b & 0x7F);
+			}
+			__val = static_cast<T>(temp);
+			return true;
+		}
+
+		static size_t encodeFloat(prot_float_t __val, char* __buf) {
+			prot_ulong_t bits;
+			memcpy(&bits, &__val, sizeof(bits));
+			return encodeInt(bits, __buf);
+		}
+
+		static bool decodeFloat(const char* __buf, size_t __len, prot_float_t& __val) {
+			prot_ulong_t temp;
+			if (!decodeInt(__buf, __len, temp)) {
+				return false;
+			}
+			memcpy(&__val, &temp, sizeof(__val));
+			return true;
+		}
+	};
+
+	/** Zigzag varint codec. Integers are sent in 7-bit groups, least significant
+	first, and only as many groups as the value needs. Signed values are zigzag
+	encoded first (0, -1, 1, -2, ... become 0, 1, 2, 3, ...), so small negative
+	numbers are short too. Channels, sub-commands, indices and most values take
+	a single byte plus the terminator.
+	
+	The terminator already marks the end of the token, so unlike the usual 
+	varint there is no continuation bit. Instead every byte has its high bit 
+	set and can never be mistaken for a control character. Floats are sent as
+	their IEEE-754 bits.
+	
+	\warning Both sides must agree on the signedness of every value. A value
+	sent as unsigned and received as signed (or the other way around) is 
+	decoded wrong, where the other codecs would get it right for small values. */
+	struct VarintCodec {
+		static const size_t INT_BYTES = (8 * sizeof(prot_ulong_t) + 6) / 7;
+		static const size_t LLONG_BYTES = (8 * sizeof(prot_ullong_t) + 6) / 7;
+		/** Room for the terminator as well as the null. @see BinaryCodec */
+		static const size_t INT_BUFF_SIZE = INT_BYTES + 2;
+		static const size_t LLONG_BUFF_SIZE = LLONG_BYTES + 2;
+		static const size_t FLOAT_BUFF_SIZE = INT_BUFF_SIZE;
+
+		static prot_ulong_t encodings() {
+			return CAP_ENC_VARINT | CAP_ENC_IEEE754;
+		}
+
+		/** Map signed values onto unsigned ones so that small magnitudes stay small. */
+		template <typename L>
+		static typename ProtWord<L>::utype zigzag(L __val) {
+			typename ProtWord<L>::utype temp = static_cast<typename ProtWord<L>::utype>(__val) << 1;
+			return __val < 0 ? ~temp : temp;
+		}
+
+		/** Inverse of zigzag() */
+		template <typename U>
+		static typename ProtWord<U>::stype unzigzag(U __val) {
+			U temp = __val >> 1;
+			return static_cast<typename ProtWord<U>::stype>((__val & 1) ? ~temp : temp);
+		}
+
+		template <typename T>
+		static size_t encodeInt(T __val, char* __buf) {
+			static_assert(sizeof(T) <= sizeof(prot_ullong_t), "encodeInt does not work for this type");
+			typedef typename ProtWord<T>::utype U;
+			typedef typename ProtWord<T>::stype L;
+			U temp;
+			if (
+				IS_SIGNED(T)) {
+				temp = zigzag(static_cast<L>(__val));
+			} else {
+				temp = static_cast<U>(__val);
+			}
+			size_t len = 0;
+			do {
+				__buf[len++] = static_cast<char>(0x80 | (temp & 0x7F));
+				temp >>= 7;
+			} while (temp);
+			return len;
+		}
+
+		template <typename T>
+		static bool decodeInt(const char* __buf, size_t __len, T& __val) {
+			static_assert(sizeof(T) <= sizeof(prot_ullong_t), "decodeInt does not work for this type");
+			typedef typename ProtWord<T>::utype U;
+			if (__len == 0 || __len > (8 * sizeof(U) + 6) / 7) {
+				return false;
+			}
+			U temp = 0;
+			for (size_t i = 0; i < __len; i++) {
+				prot_byte_t b = static_cast<prot_byte_t>(__buf[i]);
+				if (!(b & 0x80)) {
+					return false;
+				}
+				temp |= static_cast<U>(b & 0x7F) << (7 * i);
+			}
+			if (
+				IS_SIGNED(T)) {
+				__val = static_cast<T>(unzigzag(temp));
+			} else {
+				__val = static_cast<T>(temp);
+			}
+			return true;
+		}
+
+		static size_t encodeFloat(prot_float_t __val, char* __buf) {
+			prot_ulong_t bits;
+			memcpy(&bits, &__val, sizeof(bits));
+			return encodeInt(bits, __buf);
+		}
+
+		static bool decodeFloat(const char* __buf, size_t __len, prot_float_t& __val) {
+			prot_ulong_t temp;
+			if (!decodeInt(__buf, __len, temp)) {
+				return false;
+			}
+			memcpy(&__val, &temp, sizeof(__val));
+			return true;
+		}
+	};
+
+	static_assert(sizeof(prot_float_t) == sizeof(prot_ulong_t), "BinaryCodec and VarintCodec send floats as prot_ulong_t bits");
+
+	///@}
+	//////////////////////////////////////////////////////////////////////////
+
+/** Value codec of HexProtocolBase and its drivers when none is given. 
+\c \#define it before including HexProtocol.h to change the default. */
+#ifndef PROT_CODEC
+#define PROT_CODEC				HexCodec
+#endif
+
+/** Shortest run of array elements sent as one SUBCMD_ARRAY_RUN. A run is about
+as long on the wire as two single elements and saves a reply for every element 
+after the first. \c \#define it before including HexProtocol.h to change it. */
+#ifndef PROT_ARRAY_MIN_RUN
+#define PROT_ARRAY_MIN_RUN		3
+#endif
+
+	//////////////////////////////////////////////////////////////////////////
+	/// \name Array runs
+	/// \ingroup	HexProtocol 
+	///@{
+
+	/** Arithmetic runs of array elements for SUBCMD_ARRAY_RUN. Element k of a 
+	run is first + k * step. Integers wrap like unsigned values, so the step
+	between any two integers is exact. */
+	template <typename T>
+	struct ProtArrayRun {
+		typedef typename ProtWord<T>::utype utype;
+
+		/** Element __k of a run */
+		static T at(T __first, T __step, prot_ulong_t __k) {
+			return static_cast<T>(static_cast<utype>(__first) + static_cast<utype>(__k) * static_cast<utype>(__step));
+		}
+
+		/** Length of the run at the start of __pt[0..__size). Sets the __step of the run. */
+		static prot_size_t length(const T* __pt, prot_size_t __size, T& __step) {
+			__step = 0;
+			if (__size < 2) {
+				return __size;
+			}
+			__step = static_cast<T>(static_cast<utype>(__pt[1]) - static_cast<utype>(__pt[0]));
+			prot_size_t n = 2;
+			while (n < __size && at(__pt[0], __step, n) == __pt[n]) {
+				n++;
+			}
+			return n;
+		}
+	};
+
+	/** Floating point runs. The step is taken from the ends of the run so 
+	rounding does not build up along it. Elements must match to a few __eps
+	of the largest end of the run. */
+	template <typename T>
+	struct ProtFloatArrayRun {
+		static T at(T __first, T __step, prot_ulong_t __k) {
+			return __first + __step * static_cast<T>(__k);
+		}
+
+		/** Does __pt[0..__end] make one run with the step through its ends? A NaN never fits. */
+		static bool fits(const T* __pt, prot_size_t __end, T __eps) {
+			T step = (__pt[__end] - __pt[0]) / static_cast<T>(__end);
+			T first = __pt[0] < 0 ? -__pt[0] : __pt[0];
+			T last = __pt[__end] < 0 ? -__pt[__end] : __pt[__end];
+			T tol = 4 * __eps * (first > last ? first : last);
+			for (prot_size_t k = 1; k < __end; k++) {
+				T diff = at(__pt[0], step, k) - __pt[k];
+				if (!(diff <= tol && -diff <= tol)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		static prot_size_t length(const T* __pt, prot_size_t __size, T& __step, T __eps) {
+			__step = 0;
+			if (__size < 2) {
+				return __size;
+			}
+			// Double the end of the run until it no longer fits, then bisect 
+			// between the last end that fit and the first that did not. Each 
+			// check is one sweep, so a run of n costs O(n log n), not O(n^2)
+			prot_size_t good = 1, bad = __size;
+			for (prot_size_t end = 2; end < __size; ) {
+				if (!fits(__pt, end, __eps)) {
+					bad = end;
+					break;
+				}
+				good = end;
+				if (end == __size - 1) {
+					break;
+				}
+				end = (end <= (__size - 1) / 2) ? 2 * end : __size - 1;
+			}
+			while (bad - good > 1) {
+				prot_size_t mid = good + (bad - good) / 2;
+				if (fits(__pt, mid, __eps)) {
+					good = mid;
+				} else {
+					bad = mid;
+				}
+			}
+			__step = (__pt[good] - __pt[0]) / static_cast<T>(good);
+			return good + 1;
+		}
+	};
+
+	/** Runs of float elements. */
+	template <>
+	struct ProtArrayRun<prot_float_t> : public ProtFloatArrayRun<prot_float_t> {
+		static prot_size_t length(const prot_float_t* __pt, prot_size_t __size, prot_float_t& __step) {
+			return ProtFloatArrayRun<prot_float_t>::length(__pt, __size, __step, FLT_EPSILON);
+		}
+	};
+
+	/** Runs of double elements. */
+	template <>
+	struct ProtArrayRun<double> : public ProtFloatArrayRun<double> {
+		static prot_size_t length(const double* __pt, prot_size_t __size, double& __step) {
+			return ProtFloatArrayRun<double>::length(__pt, __size, __step, DBL_EPSILON);
+		}
+	};
+
+	/** Strings never make runs. */
+	template <>
+	struct ProtArrayRun<prot_string_t> {
+		static prot_string_t at(const prot_string_t& __first, const prot_string_t&, prot_ulong_t) {
+			return __first;
+		}
+
+		static prot_size_t length(const prot_string_t*, prot_size_t __size, prot_string_t&) {
+			return __size < 1 ? __size : 1;
+		}
+	};
+
+	///@}
+	//////////////////////////////////////////////////////////////////////////
+
+	//////////////////////////////////////////////////////////////////////////
+	/// \name Sequence generators
+	/// \ingroup	HexProtocol 
+	///@{
+
+	/** One instruction of a sequence generator program. @see ProtSequence */
+	template <typename T>
+	struct ProtSeqOp {
+		prot_cmd_t kind;		///< SUBCMD_SEQ_RAMP or SUBCMD_SEQ_REPEAT
+		T start;				///< ramp: first value
+		T step;					///< ramp: step between values
+		prot_ulong_t count;		///< ramp: number of values. repeat: times the block is played
+		prot_size_t block;		///< repeat: number of instructions before this one that are played again
+
+		/** __count values, __start + k * __step. A repeated value has a zero __step. */
+		static ProtSeqOp ramp(T __start, T __step, prot_ulong_t __count) {
+			ProtSeqOp op;
+			op.kind = SUBCMD_SEQ_RAMP;
+			op.start = __start;
+			op.step = __step;
+			op.count = __count;
+			op.block = 0;
+			return op;
+		}
+
+		/** Play the __block instructions before this one __times in all. */
+		static ProtSeqOp repeat(prot_size_t __block, prot_ulong_t __times) {
+			ProtSeqOp op;
+			op.kind = SUBCMD_SEQ_REPEAT;
+			op.start = op.step = T();
+			op.count = __times;
+			op.block = __block;
+			return op;
+		}
+	};
+
+	/** Slave side sequence stored as a small generator program of at most N
+	instructions. Instructions play in order, which concatenates them, and a 
+	repeat plays the block before it again like a loop. Repeats may nest.
+	Values are only computed as the sequence is stepped through, so a long 
+	sequence takes no more room than its program.
+	\code{.cpp}
+		ProtSequence<float, 8> zseq;
+		...
+		case SET_ZSEQ: processSetSequence(cmd, zseq); break;
+		...
+		float z;
+		if (!zseq.next(z)) {
+			zseq.rewind();
+			zseq.next(z);
+		}
+	\endcode
+	@tparam T	value type
+	@tparam N	maximum number of instructions
+	*/
+	template <typename T, prot_size_t N>
+	class ProtSequence {
+	public:
+		ProtSequence() {
+			clear();
+		}
+
+		/** Remove all instructions */
+		void clear() {
+			count_ = 0;
+			restart_ = false;
+			rewind();
+		}
+
+		/** Start receiving a new program. The current one is kept until the
+		first new instruction arrives, so asking for maxSize() loses nothing. */
+		void restart() {
+			restart_ = true;
+		}
+
+		/** Append a ramp. @return false if the program is full or __count is 0 */
+		bool ramp(T __start, T __step, prot_ulong_t __count) {
+			if (count_ >= N || __count == 0) {
+				return false;
+			}
+			ops_[count_++] = ProtSeqOp<T>::ramp(__start, __step, __count);
+			return true;
+		}
+
+		/** Append a repeat of the last __block instructions. 
+		@return false if the program is full or the block is empty */
+		bool repeat(prot_size_t __block, prot_ulong_t __times) {
+			if (count_ >= N || __block == 0 || __block > count_ || __times == 0) {
+				return false;
+			}
+			ops_[count_++] = ProtSeqOp<T>::repeat(__block, __times);
+			return true;
+		}
+
+		/** Append an instruction received from the host */
+		bool append(const ProtSeqOp<T>& __op) {
+			if (restart_) {
+				clear();
+			}
+			if (__op.kind == SUBCMD_SEQ_RAMP) {
+				return ramp(__op.start, __op.step, __op.count);
+			} else if (__op.kind == SUBCMD_SEQ_REPEAT) {
+				return repeat(__op.block, __op.count);
+			}
+			return false;
+		}
+
+		/** Finish receiving a program of __size instructions and rewind it.
+		@return false if instructions went missing */
+		bool finish(prot_size_t __size) {
+			if (restart_) {
+				// an empty program
+				clear();
+			}
+			restart_ = true;
+			rewind();
+			return __size == count_;
+		}
+
+		/** Start over at the first value */
+		void rewind() {
+			pc_ = 0;
+			k_ = 0;
+			for (prot_size_t i = 0; i < N; i++) {
+				played_[i] = 0;
+			}
+		}
+
+		/** Step to the next value. @return false at the end of the sequence */
+		bool next(T& __val) {
+			while (pc_ < count_) {
+				const ProtSeqOp<T>& op = ops_[pc_];
+				if (op.kind == SUBCMD_SEQ_RAMP) {
+					if (k_ < op.count) {
+						__val = ProtArrayRun<T>::at(op.start, op.step, k_++);
+						return true;
+					}
+					pc_++;
+				} else if (++played_[pc_] < op.count) {
+					pc_ -= op.block;
+				} else {
+					// leave the loop, ready for the next time we come around
+					played_[pc_] = 0;
+					pc_++;
+				}
+				k_ = 0;
+			}
+			return false;
+		}
+
+		/** Number of instructions */
+		prot_size_t size() const {
+			return count_;
+		}
+
+		/** Maximum number of instructions */
+		prot_size_t maxSize() const {
+			return N;
+		}
+
+	protected:
+		ProtSeqOp<T> ops_[N];
+		prot_ulong_t played_[N];	///< times each repeat has played its block
+		prot_size_t count_;
+		prot_size_t pc_;			///< instruction being played
+		prot_ulong_t k_;			///< next value of the ramp being played
+		bool restart_;				///< the next instruction received starts a new program
+	};
+
+	///@}
+	//////////////////////////////////////////////////////////////////////////
 
 
 	/** Syntactic sugar for conditional chaining and short-circuit evaluation.
@@ -705,6 +1814,7 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 	
 	@tparam DEV     sub-device that implements the Hex Protocol
 	@tparam S       sub-device serial stream object or name
+	@tparam CODEC   value codec such as HexCodec or BinaryCodec. @see AboutCodecs
 		@see [Curiously recurring template pattern]
 		(https://en.wikipedia.org/wiki/Curiously_recurring_template_pattern)
 		for an explanation of why we need to include the derived
@@ -712,10 +1822,13 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		of this pattern
 	*/
 
-	template <class DEV, typename S>
+	template <class DEV, typename S, class CODEC = PROT_CODEC>
 	class HexProtocolBase {
 
 	public:
+		/** The value codec */
+		typedef CODEC Codec;
+
 		/////////////////////////////////////////////////////////////////////////
 		/// \name Entry Point
 		/// Used to start the protocol.
@@ -725,29 +1838,98 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/** Begin communication.
 		@param __target will respond to serial requests via processXXX methods
 		@param __stream implementation-dependent serial stream device or name */
-		virtual void startProtocol(DEV* __target, S& __stream) {
+		PROT_IO_VIRTUAL void startProtocol(DEV* __target, S& __stream) {
 			target_ = __target;
 			stream_ = __stream;
 			started_ = true;
+			caps_ = legacyCaps();
+			capsKnown_ = false;
 		}
 
 		/** End communication. Derived class may override. */
-		virtual void endProtocol() {
+		PROT_IO_VIRTUAL void endProtocol() {
 			started_ = false;
 		}
 
 		/** Test whether startProtocol() was called. Derived class my override.
 		\warning Derived classes should check hasStarted() before using
 		the stream_ or target_ pointer. */
-		virtual bool hasStarted() {
+		PROT_IO_VIRTUAL bool hasStarted() {
 			return started_;
 		};
 
 		/** Default constructor that does nothing.
 		Use startProtocol(target,stream) before any transactions. */
-		HexProtocolBase() {}
+		HexProtocolBase() : caps_(legacyCaps()) {}
 
-		virtual ~HexProtocolBase() { }
+		/** Not virtual with PROT_STATIC_DISPATCH, so delete a DEV, never a HexProtocolBase pointer. */
+		PROT_IO_VIRTUAL ~HexProtocolBase() { }
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Capabilities
+		/// Features both sides support, negotiated once per session
+		///
+		///@{
+
+		/** Capabilities shared with the other side. Until they are negotiated
+		these are the legacyCaps(). */
+		const ProtocolCaps& caps() const {
+			return caps_;
+		}
+
+		/** Have the capabilities been negotiated this session? */
+		bool capsKnown() const {
+			return capsKnown_;
+		}
+
+		/** Do both sides support all of the CapEncodings __bits? */
+		bool hasEncoding(prot_ulong_t __bits) const {
+			return (caps_.encodings & __bits) == __bits;
+		}
+
+		/** Do both sides support all of the CapFamilies __bits? */
+		bool hasFamily(prot_ulong_t __bits) const {
+			return (caps_.families & __bits) == __bits;
+		}
+
+		/** Capabilities of this side. Derived classes add what they support. */
+		PROT_IO_VIRTUAL ProtocolCaps localCaps() {
+			ProtocolCaps caps = legacyCaps();
+			caps.version = PROT_VERSION;
+			caps.families |= CAP_FAM_PACKED_ARRAY | CAP_FAM_ARRAY_RUN | CAP_FAM_SEQ_GENERATOR;
+#ifndef PROT_NO_INT64
+			caps.encodings |= CAP_ENC_INT64;
+			if (sizeof(double) == sizeof(prot_ullong_t)) {
+				caps.encodings |= CAP_ENC_DOUBLE;
+			}
+#endif // #ifndef PROT_NO_INT64
+			return caps;
+		}
+
+		/** Capabilities of a slave that predates the capability exchange. */
+		static ProtocolCaps legacyCaps() {
+			ProtocolCaps caps;
+			caps.version = 0;
+			caps.encodings = CODEC::encodings();
+			caps.families = 0;
+			caps.rxBufferSize = 0;
+			return caps;
+		}
+
+		/** Cache the capabilities shared with the other side, given its __remote caps.
+		@return false if the other side does not use our CODEC, so values will be garbled */
+		bool setCaps(const ProtocolCaps& __remote) {
+			ProtocolCaps local = io().localCaps();
+			caps_.version = __remote.version < local.version ? __remote.version : local.version;
+			caps_.encodings = __remote.encodings & local.encodings;
+			caps_.families = __remote.families & local.families;
+			caps_.rxBufferSize = __remote.rxBufferSize;
+			capsKnown_ = true;
+			return (__remote.encodings & CODEC::encodings()) == CODEC::encodings();
+		}
 
 		///@}
 		/////////////////////////////////////////////////////////////////////////
@@ -757,10 +1939,22 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/////////////////////////////////////////////////////////////////////////
 		/// \name Common Implementation Methods, Lowest-level
 		/// Each driver must create a derived class that implements these virtual 
-		/// methods.
+		/// methods. With PROT_STATIC_DISPATCH they are not virtual, and DEV
+		/// must provide them.
 		///
 		///@{
 
+#ifdef PROT_STATIC_DISPATCH
+		/** The object that implements the low-level I/O, resolved at compile time. */
+		DEV& io() {
+			return *static_cast<DEV*>(this);
+		}
+#else
+		/** The object that implements the low-level I/O, through the vtable. */
+		HexProtocolBase& io() {
+			return *this;
+		}
+
 		/** Write a single byte */
 		virtual bool writeByte(prot_byte_t __b) = 0;
 
@@ -781,6 +1975,21 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		to increase the string buffer size. readStringUntilTerminator is primarily used for
 		getValue<prot_string_t>(). */
 		virtual size_t readStringUntilTerminator(prot_string_t& __str, char __terminator) = 0;
+#endif // PROT_STATIC_DISPATCH
+
+		/** Read a string into a caller-supplied buffer of __size bytes UNTIL a terminator 
+		character is received, or a timeout occurrs. The buffer is always null terminated.
+		Drivers that can tell when a string does not fit should discard the rest of it
+		and return 0.
+		@return length of the string, or 0 if nothing was read */
+		PROT_IO_VIRTUAL size_t readStringBufferUntilTerminator(char* __buffer, size_t __size, char __terminator) {
+			if (__size == 0) {
+				return 0;
+			}
+			size_t bytesRead = io().readBufferUntilTerminator(__buffer, __size - 1, __terminator);
+			__buffer[bytesRead] = '\0';
+			return bytesRead;
+		}
 
 		///@}
 		/////////////////////////////////////////////////////////////////////////
@@ -793,15 +2002,57 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		///@{
 
 		/** Check to see if the input buffer has a byte to read. */
-		virtual bool hasByte() {
+		PROT_IO_VIRTUAL bool hasByte() {
 			return false;
 		}
 
 		/** Read a single byte from the input buffer. */
-		virtual bool readByte(prot_byte_t&) {
+		PROT_IO_VIRTUAL bool readByte(prot_byte_t&) {
 			return false;
 		}
 
+		/** Send any output the slave has staged. Called once a command has been
+		processed, so a slave may collect each reply and write it in one piece.
+		@return false if the staged output could not be written */
+		PROT_IO_VIRTUAL bool flushReply() {
+			return true;
+		}
+
+		/** Slave read functions call this on every token they read. If the host's 
+		PROT_SYNC escape is in the token, the nonce that follows it is kept for 
+		replySync() and the read should fail.
+		@param __complete false if the read stopped at the end of the buffer
+		rather than at PROT_TERM_CHAR, so the rest of the nonce is still to come
+		@return true if the token contained PROT_SYNC */
+		bool noteSync(const char* __buf, size_t __len, bool __complete) {
+			const char* sync = static_cast<const char*>(memchr(__buf, PROT_SYNC, __len));
+			if (!sync) {
+				return false;
+			}
+			size_t nonceLen = __len - (sync + 1 - __buf);
+			syncNonceLen_ = nonceLen < sizeof(syncNonce_) ? nonceLen : sizeof(syncNonce_);
+			memcpy(syncNonce_, sync + 1, syncNonceLen_);
+			if (!__complete) {
+				syncNonceLen_ += io().readBufferUntilTerminator(syncNonce_ + syncNonceLen_, 
+					sizeof(syncNonce_) - syncNonceLen_, PROT_TERM_CHAR);
+				if (syncNonceLen_ == sizeof(syncNonce_)) {
+					// skip whatever does not fit, up to and including PROT_TERM_CHAR
+					char c;
+					while (io().readBufferUntilTerminator(&c, 1, PROT_TERM_CHAR) == 1) {
+					}
+				}
+			}
+			syncPending_ = true;
+			return true;
+		}
+
+		/** Answer a PROT_SYNC request by echoing its nonce. */
+		bool replySync() {
+			syncPending_ = false;
+			return test(io().writeByte(PROT_SYNC) && io().writeBuffer(syncNonce_, syncNonceLen_) == syncNonceLen_
+				&& io().writeByte(PROT_TERM_CHAR));
+		}
+
 		///@}
 		/////////////////////////////////////////////////////////////////////////
 
@@ -814,10 +2065,23 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		///@{
 
 		/** may be define by a device for locking a transaction */
-		virtual void lockStream() { }
+		PROT_IO_VIRTUAL void lockStream() { }
 
 		/** may be define by a device for unlocking transaction */
-		virtual void unlockStream() { }
+		PROT_IO_VIRTUAL void unlockStream() { }
+
+		/** may be defined by a device to note the start of each command,
+		for instance to time the slave's answer */
+		PROT_IO_VIRTUAL void noteCommand(prot_cmd_t) { }
+
+		/** may be defined by a device to note the channel of the current command,
+		for instance for tracing. Resolved through io(), so PROT_STATIC_DISPATCH
+		keeps it out of the slave's vtable. */
+		PROT_IO_VIRTUAL void noteChannel(prot_chan_t) { }
+
+		/** may be defined by a device to note that host and slave are out of step,
+		for instance to resync at the end of the transaction */
+		PROT_IO_VIRTUAL void noteDesync() { }
 
 	public:
 		/** Helper class to use a local variable to automatically guard the start and end of a transaction.
@@ -829,11 +2093,11 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		class StreamGuard {
 		public:
 			StreamGuard(HexProtocolBase* __pProto) : pProto_(__pProto) {
-				pProto_->lockStream();
+				pProto_->io().lockStream();
 			}
 
 			~StreamGuard() {
-				pProto_->unlockStream();
+				pProto_->io().unlockStream();
 			}
 
 		protected:
@@ -864,41 +2128,36 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/** Delegate to request a generic value. */
 		template <class DD, typename SS, typename T>
 		struct getValueDelegate {
-			static bool call(HexProtocolBase<DD, SS>* __prot, T& __t) {
-				static_assert(sizeof(T) <= sizeof(prot_ulong_t), "getValue does not work for this type");
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, T& __t) {
+				static_assert(sizeof(T) <= PROT_INT_MAX_SIZE, "getValue does not work for this type");
+				const bool wide = sizeof(T) > sizeof(prot_ulong_t);
 				// store buffer on the stack
-				char readBuf[PROT_HEX_BUFF_SIZE];
-				size_t bytesRead = __prot->readBufferUntilTerminator(readBuf, PROT_HEX_BUFF_SIZE - 1, PROT_TERM_CHAR);
+				char readBuf[wide ? CODEC::LLONG_BUFF_SIZE : CODEC::INT_BUFF_SIZE];
+				size_t bytesRead = __prot->io().readBufferUntilTerminator(readBuf, sizeof(readBuf) - 1, PROT_TERM_CHAR);
 				if (bytesRead == 0) {
 					return false;
 				}
 				// force null terminate the string for the conversion
 				readBuf[bytesRead] = '\0';
-				if (
-					IS_SIGNED(T)) {
-					/** HEX transfer of negative does not work well.
-					We will handle negatives ourselves */
-					char* negSign = strchr(readBuf, '-');
-					if (negSign) {
-						prot_long_t temp = strtoul(negSign + 1, nullptr, PROT_RADIX);
-						__t = static_cast<T>(-temp);
-					} else {
-						prot_ulong_t temp = strtoul(readBuf, nullptr, PROT_RADIX);
-						__t = static_cast<T>(temp);
+				if (wide && !__prot->hasEncoding(CAP_ENC_INT64)) {
+					// the other side only knows 32-bit integers. Decode one and widen it
+					prot_long_t stemp;
+					prot_ulong_t utemp;
+					if (IS_SIGNED(T) ? !CODEC::decodeInt(readBuf, bytesRead, stemp) : !CODEC::decodeInt(readBuf, bytesRead, utemp)) {
+						return false;
 					}
-				} else {
-					prot_ulong_t temp = strtoul(readBuf, nullptr, PROT_RADIX);
-					__t = static_cast<T>(temp);
+					__t = IS_SIGNED(T) ? static_cast<T>(stemp) : static_cast<T>(utemp);
+					return true;
 				}
-				return true;
+				return CODEC::decodeInt(readBuf, bytesRead, __t);
 			}
 		};
 
 		/* Delegate to request a string value. Template specializations for getting arbitrary string values. */
 		template <class DD, typename SS>
 		struct getValueDelegate<DD, SS, prot_string_t> {
-			static bool call(HexProtocolBase<DD, SS>* __prot, prot_string_t& __str) {
-				size_t bytesRead = __prot->readStringUntilTerminator(__str, PROT_TERM_CHAR);
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, prot_string_t& __str) {
+				size_t bytesRead = __prot->io().readStringUntilTerminator(__str, PROT_TERM_CHAR);
 				return (bytesRead != 0);
 			}
 		};
@@ -906,40 +2165,35 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/** Delegate to request a float value. Template specializations for putting floating point values */
 		template <class DD, typename SS>
 		struct getValueDelegate<DD, SS, prot_float_t> {
-			static bool call(HexProtocolBase<DD, SS>* __prot, prot_float_t& __val) {
-#ifdef PROT_FLOAT_IEEE754
-				/** The BIG assumption is that floats are IEEE-754 on both sides of the transfer. */
-				prot_ulong_t temp;
-				if (!__prot->template getValue<prot_ulong_t>(temp)) {
-					return false;
-				}
-				__val = *reinterpret_cast<prot_float_t*>(&temp);
-				return true;
-#else // NOT #ifdef PROT_FLOAT_IEEE754
-
-
-
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, prot_float_t& __val) {
 				// store buffer on the stack
-				char buf[PROT_FLOAT_BUFF_SIZE ];
-				size_t bytesRead = __prot->readBufferUntilTerminator(buf, PROT_FLOAT_BUFF_SIZE - 1, PROT_TERM_CHAR);
+				char buf[CODEC::FLOAT_BUFF_SIZE];
+				size_t bytesRead = __prot->io().readBufferUntilTerminator(buf, CODEC::FLOAT_BUFF_SIZE - 1, PROT_TERM_CHAR);
 				if (bytesRead == 0) {
 					return false;
 				}
 				// force null terminate the string for the conversion
 				buf[bytesRead] = '\0';
-				__val = static_cast<prot_float_t>(prot_strtof(buf));
-				return true;
-#endif // #ifdef PROT_FLOAT_IEEE754
-
-
-
+				return CODEC::decodeFloat(buf, bytesRead, __val);
 			}
 		};
 
 		/** Delegate to request a double value. Template specializations for getting double values */
 		template <class DD, typename SS>
 		struct getValueDelegate<DD, SS, double> {
-			static bool call(HexProtocolBase<DD, SS>* __prot, double& __val) {
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, double& __val) {
+#ifndef PROT_NO_INT64
+				if (sizeof(double) == sizeof(prot_ullong_t) && __prot->hasEncoding(CAP_ENC_DOUBLE)) {
+					/** The BIG assumption is that doubles are IEEE-754 on both sides of the transfer. */
+					prot_ullong_t temp;
+					if (!__prot->template getValue<prot_ullong_t>(temp)) {
+						return false;
+					}
+					memcpy(&__val, &temp, sizeof(__val));
+					return true;
+				}
+#endif // #ifndef PROT_NO_INT64
+				// the other side narrows doubles to floats
 				prot_float_t temp;
 				bool ret = __prot->template getValue<prot_float_t>(temp);
 				__val = temp;
@@ -954,14 +2208,10 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 			return getValueDelegate<DEV, S, T>::call(this, __t);
 		}
 
-		/** Request a string buffer explicitely. */
+		/** Request a string buffer explicitely. At most __size - 1 characters
+		are stored and the string is always null terminated. */
 		bool getString(char* __strbuf, size_t __size) {
-			size_t bytesRead = readBufferUntilTerminator(__strbuf, __size, PROT_TERM_CHAR);
-			// force null terminate the string
-			if (bytesRead < __size - 1) {
-				__strbuf[bytesRead] = '\0';
-			}
-			return (bytesRead != 0);
+			return (io().readStringBufferUntilTerminator(__strbuf, __size, PROT_TERM_CHAR) != 0);
 		}
 
 		///@}
@@ -987,28 +2237,33 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/** Delegate to send a generic value. */
 		template <class DD, typename SS, typename T>
 		struct putValueDelegate {
-			static bool call(HexProtocolBase<DD, SS>* __prot, T __val) {
-				static_assert(sizeof(T) <= sizeof(prot_ulong_t), "putValue does not work for this type");
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, T __val) {
+				static_assert(sizeof(T) <= PROT_INT_MAX_SIZE, "putValue does not work for this type");
+				const bool wide = sizeof(T) > sizeof(prot_ulong_t);
 				// store buffer on the stack
-				char writeBuf[PROT_HEX_BUFF_SIZE];
-				if (
-					IS_SIGNED(T)) {
-					prot_long_t temp = static_cast<prot_long_t>(__val);
-					if (temp < 0) {
-						/** HEX transfer of negative does not work well.
-						We will handle negatives ourselves */
-						writeBuf[0] = '-';
-						prot_ultohexstr(-temp, writeBuf + 1, PROT_RADIX);
+				char writeBuf[wide ? CODEC::LLONG_BUFF_SIZE : CODEC::INT_BUFF_SIZE];
+				size_t len;
+				if (wide && !__prot->hasEncoding(CAP_ENC_INT64)) {
+					// the other side only knows 32-bit integers. Send one if the value fits
+					if (
+						IS_SIGNED(T)) {
+						prot_long_t temp = static_cast<prot_long_t>(__val);
+						if (static_cast<T>(temp) != __val) {
+							return false;
+						}
+						len = CODEC::encodeInt(temp, writeBuf);
 					} else {
-						prot_ultohexstr(temp, writeBuf, PROT_RADIX);
+						prot_ulong_t temp = static_cast<prot_ulong_t>(__val);
+						if (static_cast<T>(temp) != __val) {
+							return false;
+						}
+						len = CODEC::encodeInt(temp, writeBuf);
 					}
 				} else {
-					prot_ulong_t temp = static_cast<prot_ulong_t>(__val);
-					prot_ultohexstr(temp, writeBuf, PROT_RADIX);
+					len = CODEC::encodeInt(__val, writeBuf);
 				}
-				size_t len = strlen(writeBuf);
 				writeBuf[len++] = PROT_TERM_CHAR ;
-				size_t bytesWritten = __prot->writeBuffer(writeBuf, len);
+				size_t bytesWritten = __prot->io().writeBuffer(writeBuf, len);
 				return (bytesWritten == len);
 			}
 		};
@@ -1016,7 +2271,7 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/* Delegate to send a string value. Template specializations for putting arbitrary string values*/
 		template <class DD, typename SS>
 		struct putValueDelegate<DD, SS, prot_string_t> {
-			static bool call(HexProtocolBase<DD, SS>* __prot, const prot_string_t __str) {
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, const prot_string_t __str) {
 				return __prot->putString(__str.c_str());
 			}
 		};
@@ -1024,7 +2279,7 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/* Delegate to send a char* string value. Template specializations for putting arbitrary string buffer values*/
 		template <class DD, typename SS>
 		struct putValueDelegate<DD, SS, const char*> {
-			static bool call(HexProtocolBase<DD, SS>* __prot, const char* __strbuf) {
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, const char* __strbuf) {
 				return __prot->putString(__strbuf);
 			}
 		};
@@ -1032,27 +2287,29 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/** Delegate to send a float value. Template specializations for getting floating point values */
 		template <class DD, typename SS>
 		struct putValueDelegate<DD, SS, prot_float_t> {
-			static bool call(HexProtocolBase<DD, SS>* __prot, prot_float_t __val) {
-#ifdef PROT_FLOAT_IEEE754
-				/** The BIG assumption is that floats are IEEE-754 on both sides of the transfer. */
-				prot_ulong_t temp = *reinterpret_cast<prot_ulong_t*>(&__val);
-				return __prot->template putValue<prot_ulong_t>(temp);
-#else // NOT #ifdef PROT_FLOAT_IEEE754
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, prot_float_t __val) {
 				// store buffer on the stack
-				char buf[PROT_FLOAT_BUFF_SIZE ];
-				prot_ftostr(__val, buf, PROT_FLOAT_BUFF_SIZE, PROT_FLOAT_MAX_PREC);
-				size_t len = strlen(buf);
+				char buf[CODEC::FLOAT_BUFF_SIZE];
+				size_t len = CODEC::encodeFloat(__val, buf);
 				buf[len++] = PROT_TERM_CHAR ;
-				size_t bytesWritten = __prot->writeBuffer(buf, len);
+				size_t bytesWritten = __prot->io().writeBuffer(buf, len);
 				return (bytesWritten == len);
-#endif // #ifdef PROT_FLOAT_IEEE754
 			}
 		};
 
 		/** Delegate to send a double value. Template specializations for putting double values */
 		template <class DD, typename SS>
 		struct putValueDelegate<DD, SS, double> {
-			static bool call(HexProtocolBase<DD, SS>* __prot, double __val) {
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, double __val) {
+#ifndef PROT_NO_INT64
+				if (sizeof(double) == sizeof(prot_ullong_t) && __prot->hasEncoding(CAP_ENC_DOUBLE)) {
+					/** The BIG assumption is that doubles are IEEE-754 on both sides of the transfer. */
+					prot_ullong_t bits = 0;
+					memcpy(&bits, &__val, sizeof(__val));
+					return __prot->template putValue<prot_ullong_t>(bits);
+				}
+#endif // #ifndef PROT_NO_INT64
+				// the other side only knows floats
 				return __prot->template putValue<prot_float_t>(static_cast<prot_float_t>(__val));
 			}
 		};
@@ -1066,15 +2323,173 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/** Send a string buffer explicitely. */
 		bool putString(const char* __str) {
 			size_t len = strlen(__str);
-			size_t bytesWritten = len > 0 ? writeBuffer(__str, len) : 0;
+			size_t bytesWritten = len > 0 ? io().writeBuffer(__str, len) : 0;
 			char term = PROT_TERM_CHAR;
-			bytesWritten += writeBuffer(&term, 1);
+			bytesWritten += io().writeBuffer(&term, 1);
 			return (bytesWritten == len + 1);
 		}
 
 		///@}
 		/////////////////////////////////////////////////////////////////////////
 
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Array elements, Low-level
+		///
+		/// Array elements go through their own delegates so float and
+		/// double sequences can be packed (see SUBCMD_ARRAY_FORMAT).
+		/// Every other element type is sent as a plain value.
+		///
+		///@{
+
+		/** Delegate to receive a generic array element. */
+		template <class DD, typename SS, typename T>
+		struct getElementDelegate {
+			static const bool packable = false;
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, T& __el) {
+				return __prot->getValue(__el);
+			}
+		};
+
+		/** Delegate to receive a float array element. Expands packed elements. */
+		template <class DD, typename SS>
+		struct getElementDelegate<DD, SS, prot_float_t> {
+			static const bool packable = true;
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, prot_float_t& __el) {
+				switch (__prot->arrayPacking_.format) {
+				case ARRAY_FORMAT_HALF: {
+					prot_half_t half;
+					if (!__prot->getValue(half)) {
+						return false;
+					}
+					__el = prot_halftof(half);
+					return true;
+				}
+				case ARRAY_FORMAT_FIXED: {
+					prot_long_t steps;
+					if (!__prot->getValue(steps)) {
+						return false;
+					}
+					__el = __prot->arrayPacking_.fromSteps(steps);
+					return true;
+				}
+				default:
+					return __prot->getValue(__el);
+				}
+			}
+		};
+
+		/** Delegate to receive a double array element. Packed elements are expanded as floats. */
+		template <class DD, typename SS>
+		struct getElementDelegate<DD, SS, double> {
+			static const bool packable = true;
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, double& __el) {
+				if (__prot->arrayPacking_.format == ARRAY_FORMAT_NATIVE) {
+					return __prot->getValue(__el);
+				}
+				prot_float_t temp;
+				bool ret = getElementDelegate<DD, SS, prot_float_t>::call(__prot, temp);
+				__el = temp;
+				return ret;
+			}
+		};
+
+		/** Delegate to send a generic array element. */
+		template <class DD, typename SS, typename T>
+		struct putElementDelegate {
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, const T& __el, const ArrayPacking&) {
+				return __prot->putValue(__el);
+			}
+		};
+
+		/** Delegate to send a float array element, packed as asked. */
+		template <class DD, typename SS>
+		struct putElementDelegate<DD, SS, prot_float_t> {
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, const prot_float_t& __el, const ArrayPacking& __packing) {
+				switch (__packing.format) {
+				case ARRAY_FORMAT_HALF:
+					return __prot->putValue(prot_ftohalf(__el));
+				case ARRAY_FORMAT_FIXED:
+					return __prot->putValue(__packing.toSteps(__el));
+				default:
+					return __prot->putValue(__el);
+				}
+			}
+		};
+
+		/** Delegate to send a double array element. Packed elements are narrowed to floats first. */
+		template <class DD, typename SS>
+		struct putElementDelegate<DD, SS, double> {
+			static bool call(HexProtocolBase<DD, SS, CODEC>* __prot, const double& __el, const ArrayPacking& __packing) {
+				if (__packing.format == ARRAY_FORMAT_NATIVE) {
+					return __prot->putValue(__el);
+				}
+				return putElementDelegate<DD, SS, prot_float_t>::call(__prot, static_cast<prot_float_t>(__el), __packing);
+			}
+		};
+
+		/** Receive an array element, expanding it if the sender packed it. Calls the correct Delegate. */
+		template <typename T>
+		bool getArrayElement(T& __el) {
+			return getElementDelegate<DEV, S, T>::call(this, __el);
+		}
+
+		/** Send an array element packed with __packing. Calls the correct Delegate. */
+		template <typename T>
+		bool putArrayElement(const T& __el, const ArrayPacking& __packing) {
+			return putElementDelegate<DEV, S, T>::call(this, __el, __packing);
+		}
+
+		/** Send the arguments of SUBCMD_ARRAY_FORMAT. */
+		bool putArrayPacking(const ArrayPacking& __packing) {
+			if (__packing.format != ARRAY_FORMAT_FIXED) {
+				return putValue(__packing.format);
+			}
+			return test(putValue(__packing.format) && putValue(__packing.scale) && putValue(__packing.offset));
+		}
+
+		/** Send a sequence generator instruction, starting with its sub-command. */
+		template <typename T>
+		bool putSeqOp(const ProtSeqOp<T>& __op) {
+			if (__op.kind == SUBCMD_SEQ_RAMP) {
+				return test(putValue(__op.kind) && putValue(__op.start) && putValue(__op.step) && putValue(__op.count));
+			}
+			return test(putValue(__op.kind) && putValue(__op.block) && putValue(__op.count));
+		}
+
+		/** Receive the arguments of a sequence generator instruction after its __kind sub-command. */
+		template <typename T>
+		bool getSeqOp(prot_cmd_t __kind, ProtSeqOp<T>& __op) {
+			__op.kind = __kind;
+			if (__kind == SUBCMD_SEQ_RAMP) {
+				__op.block = 0;
+				return test(getValue(__op.start) && getValue(__op.step) && getValue(__op.count));
+			}
+			__op.start = __op.step = T();
+			return test(getValue(__op.block) && getValue(__op.count));
+		}
+
+		/** Receive the arguments of SUBCMD_ARRAY_FORMAT for an array of T. All
+		arguments are read before a format is refused, so none are left on the line.
+		@return false if T cannot be expanded from that format */
+		template <typename T>
+		bool getArrayPacking() {
+			ArrayPacking packing;
+			if (!getValue(packing.format)) {
+				return false;
+			}
+			if (packing.format == ARRAY_FORMAT_FIXED && !test(getValue(packing.scale) && getValue(packing.offset))) {
+				return false;
+			}
+			if (packing.format > ARRAY_FORMAT_FIXED || (packing.format != ARRAY_FORMAT_NATIVE && !getElementDelegate<DEV, S, T>::packable)) {
+				return false;
+			}
+			arrayPacking_ = packing;
+			return true;
+		}
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
 		/////////////////////////////////////////////////////////////////////////
 		/// \name Sending and receiving commands, Mid-level
 		///
@@ -1082,11 +2497,13 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 
 		/** Write a single byte to the output */
 		bool putCommand(prot_cmd_t __cmd) {
-			return writeByte(static_cast<prot_byte_t>(__cmd));
+			io().noteCommand(__cmd);
+			return io().writeByte(static_cast<prot_byte_t>(__cmd));
 		}
 
 		/** Write a single byte to the output followed by a channel number*/
 		bool putChannelCommand(prot_cmd_t __cmd, prot_chan_t __c) {
+			io().noteChannel(__c);
 			return test(putCommand(__cmd) && putValue<prot_chan_t>(__c));
 		}
 
@@ -1098,26 +2515,84 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		/** Send encoded reply of PROT_ERROR to the output.
 		ALWAYS returns false, so you functions may return replyError() straight away */
 		bool replyError() {
+			if (syncPending_) {
+				// the command failed because the host asked for a resync
+				replySync();
+				return false;
+			}
 			putValue<prot_cmd_t>(PROT_ERROR);
 			return false;
 		}
 
-		/** was the reply good? */
+		/** Tell the host that the slave has booted and is ready for commands.
+		Call once at the end of the slave's setup(). The capabilities go back
+		to the legacyCaps() until the host negotiates them again. */
+		bool announceReady() {
+			caps_ = legacyCaps();
+			capsKnown_ = false;
+			return test(io().writeByte(PROT_READY) && io().writeByte(PROT_TERM_CHAR) && io().flushReply());
+		}
+
+		/** was the reply good? 
+		
+		The slave answers either the command or PROT_ERROR in place of the 
+		reply, never after it. So every dispatch reads the reply before any 
+		value and a PROT_ERROR ends the chain after a single token. */
 		bool checkReply(prot_cmd_t __cmd) {
 			prot_cmd_t answer = 0;
-			return test(getValue<prot_cmd_t>(answer) && (answer == __cmd));
+			if (!getValue<prot_cmd_t>(answer)) {
+				return false;
+			}
+			if (answer != __cmd && answer != PROT_ERROR) {
+				// not a clean error. We are reading someone else's reply
+				io().noteDesync();
+			}
+			return (answer == __cmd);
+		}
+
+		/** Send the PROT_SYNC escape with __nonce and discard every token up to 
+		the slave's matching sync reply.
+		@param __maxTokens give up after this many tokens
+		@return true if the slave is back in sync */
+		bool dispatchSync(prot_ulong_t __nonce, int __maxTokens = 16) {
+			char expect[CODEC::INT_BUFF_SIZE + 1];
+			expect[0] = PROT_SYNC;
+			size_t expectLen = 1 + CODEC::encodeInt(__nonce, expect + 1);
+			if (!test(putCommand(PROT_SYNC) && putValue(__nonce))) {
+				return false;
+			}
+			char token[CODEC::INT_BUFF_SIZE + 1];
+			int timeouts = 0;
+			for (int i = 0; i < __maxTokens && timeouts < 2; i++) {
+				size_t len = io().readBufferUntilTerminator(token, sizeof(token) - 1, PROT_TERM_CHAR);
+				if (len == 0) {
+					timeouts++;
+				} else if (len == expectLen && memcmp(token, expect, len) == 0) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/** Send our __local capabilities to the slave and get its __remote ones.
+		@return false if the slave does not support PROT_SYS_CAPS */
+		bool dispatchCaps(const ProtocolCaps& __local, ProtocolCaps& __remote) {
+			return test(putCommand(PROT_SYS_CAPS) && putValue(__local.version) && putValue(__local.encodings)
+				&& putValue(__local.families) && putValue(__local.rxBufferSize) && checkReply(PROT_SYS_CAPS)
+				&& getValue(__remote.version) && getValue(__remote.encodings) && getValue(__remote.families)
+				&& getValue(__remote.rxBufferSize));
 		}
 
 		/** Determine whether a single byte is in the read buffer */
 		bool hasCommand() {
-			return hasByte();
+			return io().hasByte();
 		}
 
 
 		/** get a single byte command from the read buffer */
 		prot_cmd_t getCommand() {
 			prot_byte_t b;
-			if (readByte(b)) {
+			if (io().readByte(b)) {
 				return static_cast<prot_cmd_t>(b);
 			}
 			return PROT_ERROR ;
@@ -1150,7 +2625,7 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 
 		/** Dispatch a get string command. */
 		bool dispatchGetString(prot_cmd_t __cmdSet, char* __strbuf, size_t __size) {
-			return test(putCommand(__cmdSet) && getString(__strbuf, __size) && checkReply(__cmdSet));
+			return test(putCommand(__cmdSet) && checkReply(__cmdSet) && getString(__strbuf, __size));
 		}
 
 		/** Dispatch a set single value command. */
@@ -1199,7 +2674,7 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 
 		/** Dispatch a get string command to a specific channel. */
 		bool dispatchChannelGetString(prot_cmd_t __cmdSet, prot_chan_t __chan, char* __strbuf, size_t __size) {
-			return test(putChannelCommand(__cmdSet, __chan) && getString(__strbuf, __size) && checkReply(__cmdSet));
+			return test(putChannelCommand(__cmdSet, __chan) && checkReply(__cmdSet) && getString(__strbuf, __size));
 		}
 
 		/** Dispatch a set single value command to a specific channel. */
@@ -1235,11 +2710,22 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 			getValue(maxSize)
 			// check that the array will fit
 			check size <= maxSize
-			// send the elements
-			for (i=0; i<size; i++) {
-				putCommand(SET, SUBCMD_ARRAY_ELEMENT)
-				putValue(i)
-				putValue(element[i])
+			// pack float elements if asked and the slave can expand them
+			if (packing != native && hasFamily(CAP_FAM_PACKED_ARRAY))
+				putCommand(SET, SUBCMD_ARRAY_FORMAT)
+				putArrayPacking(packing)
+			// send the elements, runs at once if the slave can expand them
+			for (i=0; i<size; ) {
+				if (hasFamily(CAP_FAM_ARRAY_RUN) && run at i is >= PROT_ARRAY_MIN_RUN long) {
+					putCommand(SET, SUBCMD_ARRAY_RUN)
+					putValue(i), putValue(count), putValue(element[i]), putValue(step)
+					i += count
+				} else {
+					putCommand(SET, SUBCMD_ARRAY_ELEMENT)
+					putValue(i)
+					putArrayElement(element[i], packing)
+					i++
+				}
 			}
 			// send the finished marker
 			putCommand(SET, SUBCMD_ARRAY_FINISHED)
@@ -1247,19 +2733,40 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		\endcode
 		*/
 		template <typename T>
-		bool dispatchSetArray(prot_cmd_t __cmdSet, const T* __pt, prot_size_t __size) {
+		bool dispatchSetArray(prot_cmd_t __cmdSet, const T* __pt, prot_size_t __size, const ArrayPacking& __packing = ArrayPacking()) {
 			// get the maximum size of the remote array
 			prot_size_t maxSize;
 			if (!test(putCommand(__cmdSet) && putValue<prot_cmd_t>(SUBCMD_ARRAY_SIZE)
 				&& checkReply(__cmdSet) && getValue(maxSize) && __size <= maxSize)) {
 				return false;
 			}
-			// Set the elements
-			for (prot_size_t i = 0; i < __size; i++) {
-				if (!test(putCommand(__cmdSet) && putValue<prot_cmd_t>(SUBCMD_ARRAY_ELEMENT)
-					&& putValue(i) && putValue(__pt[i]) && checkReply(__cmdSet))) {
+			// Pack the elements only if the slave can expand them
+			ArrayPacking packing;
+			if (__packing.format != ARRAY_FORMAT_NATIVE && hasFamily(CAP_FAM_PACKED_ARRAY)) {
+				if (!test(putCommand(__cmdSet) && putValue<prot_cmd_t>(SUBCMD_ARRAY_FORMAT)
+					&& putArrayPacking(__packing) && checkReply(__cmdSet))) {
 					return false;
 				}
+				packing = __packing;
+			}
+			// Set the elements. Send runs at once if the slave can expand them
+			bool useRuns = hasFamily(CAP_FAM_ARRAY_RUN);
+			for (prot_size_t i = 0; i < __size; ) {
+				T step;
+				prot_size_t count = useRuns ? ProtArrayRun<T>::length(__pt + i, __size - i, step) : 1;
+				if (count >= PROT_ARRAY_MIN_RUN) {
+					if (!test(putCommand(__cmdSet) && putValue<prot_cmd_t>(SUBCMD_ARRAY_RUN)
+						&& putValue(i) && putValue(count) && putValue(__pt[i]) && putValue(step) && checkReply(__cmdSet))) {
+						return false;
+					}
+					i += count;
+				} else {
+					if (!test(putCommand(__cmdSet) && putValue<prot_cmd_t>(SUBCMD_ARRAY_ELEMENT)
+						&& putValue(i) && putArrayElement(__pt[i], packing) && checkReply(__cmdSet))) {
+						return false;
+					}
+					i++;
+				}
 			}
 
 			// Finalize by setting the length
@@ -1324,25 +2831,68 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 			return true;
 		}
 
+		/** Send a sequence generator program to a slave that handles __cmdSet with
+		processSetSequence(). The cost depends on the number of instructions, not
+		on the number of values they generate. @see AboutSubCommands */
+		template <typename T>
+		bool dispatchSetSequence(prot_cmd_t __cmdSet, const ProtSeqOp<T>* __ops, prot_size_t __size) {
+			// start a new remote program and get its maximum size
+			prot_size_t maxSize;
+			if (!test(putCommand(__cmdSet) && putValue<prot_cmd_t>(SUBCMD_ARRAY_SIZE)
+				&& checkReply(__cmdSet) && getValue(maxSize) && __size <= maxSize)) {
+				return false;
+			}
+			// Append the instructions
+			for (prot_size_t i = 0; i < __size; i++) {
+				if (!test(putCommand(__cmdSet) && putSeqOp(__ops[i]) && checkReply(__cmdSet))) {
+					return false;
+				}
+			}
+			// Finalize with the number of instructions
+			return test(putCommand(__cmdSet) && putValue<prot_cmd_t>(SUBCMD_ARRAY_FINISHED)
+				&& putValue(__size) && checkReply(__cmdSet));
+		}
+
 		/////////////////////////////////////////////////////////////////////////
 		/// \name Channel Array Command dispatching (sending), High-level
 		///
 		///@{
 
 		template <typename T>
-		bool dispatchChannelSetArray(prot_cmd_t __cmdSet, prot_chan_t __chan, const T* __pt, prot_size_t __size) {
+		bool dispatchChannelSetArray(prot_cmd_t __cmdSet, prot_chan_t __chan, const T* __pt, prot_size_t __size, const ArrayPacking& __packing = ArrayPacking()) {
 			// get the maximum size of the remote array
 			prot_size_t maxSize;
 			if (!test(putChannelCommand(__cmdSet, __chan) && putValue<prot_cmd_t>(SUBCMD_ARRAY_SIZE)
 				&& checkReply(__cmdSet) && getValue(maxSize) && __size <= maxSize)) {
 				return false;
 			}
-			// Set the elements
-			for (prot_size_t i = 0; i < __size; i++) {
-				if (!test(putChannelCommand(__cmdSet, __chan) && putValue<prot_cmd_t>(SUBCMD_ARRAY_ELEMENT)
-					&& putValue(i) && putValue(__pt[i]) && checkReply(__cmdSet))) {
+			// Pack the elements only if the slave can expand them
+			ArrayPacking packing;
+			if (__packing.format != ARRAY_FORMAT_NATIVE && hasFamily(CAP_FAM_PACKED_ARRAY)) {
+				if (!test(putChannelCommand(__cmdSet, __chan) && putValue<prot_cmd_t>(SUBCMD_ARRAY_FORMAT)
+					&& putArrayPacking(__packing) && checkReply(__cmdSet))) {
 					return false;
 				}
+				packing = __packing;
+			}
+			// Set the elements. Send runs at once if the slave can expand them
+			bool useRuns = hasFamily(CAP_FAM_ARRAY_RUN);
+			for (prot_size_t i = 0; i < __size; ) {
+				T step;
+				prot_size_t count = useRuns ? ProtArrayRun<T>::length(__pt + i, __size - i, step) : 1;
+				if (count >= PROT_ARRAY_MIN_RUN) {
+					if (!test(putChannelCommand(__cmdSet, __chan) && putValue<prot_cmd_t>(SUBCMD_ARRAY_RUN)
+						&& putValue(i) && putValue(count) && putValue(__pt[i]) && putValue(step) && checkReply(__cmdSet))) {
+						return false;
+					}
+					i += count;
+				} else {
+					if (!test(putChannelCommand(__cmdSet, __chan) && putValue<prot_cmd_t>(SUBCMD_ARRAY_ELEMENT)
+						&& putValue(i) && putArrayElement(__pt[i], packing) && checkReply(__cmdSet))) {
+						return false;
+					}
+					i++;
+				}
 			}
 
 			// Finalize by setting the length
@@ -1389,6 +2939,26 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 			return true;
 		}
 
+		/** Send a sequence generator program on a specific channel. @see dispatchSetSequence */
+		template <typename T>
+		bool dispatchChannelSetSequence(prot_cmd_t __cmdSet, prot_chan_t __chan, const ProtSeqOp<T>* __ops, prot_size_t __size) {
+			// start a new remote program and get its maximum size
+			prot_size_t maxSize;
+			if (!test(putChannelCommand(__cmdSet, __chan) && putValue<prot_cmd_t>(SUBCMD_ARRAY_SIZE)
+				&& checkReply(__cmdSet) && getValue(maxSize) && __size <= maxSize)) {
+				return false;
+			}
+			// Append the instructions
+			for (prot_size_t i = 0; i < __size; i++) {
+				if (!test(putChannelCommand(__cmdSet, __chan) && putSeqOp(__ops[i]) && checkReply(__cmdSet))) {
+					return false;
+				}
+			}
+			// Finalize with the number of instructions
+			return test(putChannelCommand(__cmdSet, __chan) && putValue<prot_cmd_t>(SUBCMD_ARRAY_FINISHED)
+				&& putValue(__size) && checkReply(__cmdSet));
+		}
+
 		///@}
 		/////////////////////////////////////////////////////////////////////////
 
@@ -1416,11 +2986,59 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 			typedef void (DEV::*type)(prot_cmd_t __cmd);
 		};
 
-		/** A single entry point for command handling. Calls a ProcessCommandFn. */
+		/** Handle a reserved system command (see \ref AboutHexProtocol).
+		Slave implementations override this to add system commands, and 
+		call the base version for the rest.
+		@return true if __cmd was a system command and has been handled */
+		PROT_IO_VIRTUAL bool processSystemCommand(prot_cmd_t __cmd) {
+			if (__cmd < PROT_SYS_FIRST || __cmd > PROT_SYS_LAST) {
+				return false;
+			}
+			switch (__cmd) {
+			case PROT_SYS_PING:
+				reply(__cmd);
+				break;
+			case PROT_SYS_CAPS: {
+				ProtocolCaps host;
+				if (!test(getValue(host.version) && getValue(host.encodings) && getValue(host.families)
+						&& getValue(host.rxBufferSize))) {
+					replyError();
+					break;
+				}
+				ProtocolCaps caps = io().localCaps();
+				test(reply(__cmd) && putValue(caps.version) && putValue(caps.encodings) && putValue(caps.families)
+					&& putValue(caps.rxBufferSize));
+				// only use what the host supports too
+				setCaps(host);
+				break;
+			}
+			case PROT_SYNC:
+				// idle slave. The nonce is the next token
+				syncNonceLen_ = io().readBufferUntilTerminator(syncNonce_, sizeof(syncNonce_), PROT_TERM_CHAR);
+				replySync();
+				break;
+			case PROT_SYS_BAUD: {
+				// consume the arguments so they are not mistaken for commands
+				prot_ulong_t newBaud, oldBaud;
+				test(getValue(newBaud) && getValue(oldBaud));
+				replyError();
+				break;
+			}
+			default:
+				// reserved, but not supported by this slave
+				replyError();
+			}
+			return true;
+		}
+
+		/** A single entry point for command handling. System commands are handled
+		by processSystemCommand(), all others are passed to a ProcessCommandFn.
+		Staged output is flushed once the command has been handled. */
 		void processCommand(prot_cmd_t __cmd, typename CommandFn::type __processFn) {
-			if (target_) {
+			if (!io().processSystemCommand(__cmd) && target_) {
 				(target_ ->* __processFn)(__cmd);
 			}
+			io().flushReply();
 		};
 
 		//-----------------------------------------------------------------------
@@ -1599,7 +3217,7 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		bool processGet(prot_cmd_t __cmdGet, T __val, typename TaskFn::type __beforeGet = 0) {
 			if (__beforeGet) {
 				if (!test(target_ && (target_ ->* __beforeGet)())) {
-					replyError();
+					return replyError();
 				}
 			}
 			return test(reply(__cmdGet) && putValue<T>(__val));
@@ -1657,7 +3275,7 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		bool processGet(prot_cmd_t __cmdGet, T __t_val, U __u_val, typename TaskFn::type __beforeGet = 0) {
 			if (__beforeGet) {
 				if (!test(target_ && (target_ ->* __beforeGet)())) {
-					replyError();
+					return replyError();
 				}
 			}
 			return test(reply(__cmdGet) && putValue<T>(__t_val) && putValue<U>(__u_val));
@@ -1801,7 +3419,7 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		bool processGetString(prot_cmd_t __cmdGet, const char* __str, typename TaskFn::type __beforeGet = 0) {
 			if (__beforeGet) {
 				if (!test(target_ && (target_ ->* __beforeGet)())) {
-					replyError();
+					return replyError();
 				}
 			}
 			return test(reply(__cmdGet) && putString(__str));
@@ -1864,22 +3482,41 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		and checked after the value is set. */
 		template <typename T>
 		bool processSetArray(prot_cmd_t __cmdSet, T* __pArr, size_t __maxSize, size_t& __finalSize, typename TaskFn::type __afterSet = 0) {
-			int subCmd;
-			if (!getValue<int>(subCmd)) {
+			prot_cmd_t subCmd;
+			if (!getValue(subCmd)) {
 				return replyError();
 			}
 			if (subCmd == SUBCMD_ARRAY_SIZE) {
+				arrayPacking_ = ArrayPacking();
 				return test(reply(__cmdSet) && putValue(__maxSize));
+			} else if (subCmd == SUBCMD_ARRAY_FORMAT) {
+				if (getArrayPacking<T>()) {
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
 			} else if (subCmd == SUBCMD_ARRAY_ELEMENT) {
 				prot_size_t index;
 				T el;
-				if (test(getValue(index) && getValue(el) && index < __maxSize)) {
+				if (test(getValue(index) && getArrayElement(el) && index < __maxSize)) {
 					__pArr[index] = el;
 					return reply(__cmdSet);
 				} else {
 					return replyError();
 				}
+			} else if (subCmd == SUBCMD_ARRAY_RUN) {
+				prot_size_t index, count;
+				T first, step;
+				if (test(getValue(index) && getValue(count) && getValue(first) && getValue(step) && index <= __maxSize && count <= __maxSize - index)) {
+					for (prot_size_t k = 0; k < count; k++) {
+						__pArr[index + k] = ProtArrayRun<T>::at(first, step, k);
+					}
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
 			} else if (subCmd == SUBCMD_ARRAY_FINISHED) {
+				arrayPacking_ = ArrayPacking();
 				if (getValue(__finalSize)) {
 					if (__afterSet) {
 						if (!test(target_ && (target_ ->* __afterSet)())) {
@@ -1932,20 +3569,27 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 			maxSize = 0;
 			bool goodArray = test(target_ && (target_ ->* __arrFn)(pArr, maxSize, 0));
 
-			int subCmd;
-			if (!getValue<int>(subCmd)) {
+			prot_cmd_t subCmd;
+			if (!getValue(subCmd)) {
 				return replyError();
 			}
 			if (subCmd == SUBCMD_ARRAY_SIZE) {
+				arrayPacking_ = ArrayPacking();
 				if (goodArray) {
 					return test(reply(__cmdSet) && putValue(maxSize));
 				} else {
 					return replyError();
 				}
+			} else if (subCmd == SUBCMD_ARRAY_FORMAT) {
+				if (test(getArrayPacking<T>() && goodArray)) {
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
 			} else if (subCmd == SUBCMD_ARRAY_ELEMENT) {
 				prot_size_t index;
 				T el;
-				if (test(getValue(index) && getValue(el) && index < maxSize && goodArray)) {
+				if (test(getValue(index) && getArrayElement(el) && index < maxSize && goodArray)) {
 					if (index == 0) {
 						if (!test(target_ && (target_->*__arrFn)(pArr, maxSize, 0))) {
 							return replyError();
@@ -1956,7 +3600,25 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 				} else {
 					return replyError();
 				}
+			} else if (subCmd == SUBCMD_ARRAY_RUN) {
+				prot_size_t index, count;
+				T first, step;
+				if (test(getValue(index) && getValue(count) && getValue(first) && getValue(step) 
+					&& index <= maxSize && count <= maxSize - index && goodArray)) {
+					if (index == 0) {
+						if (!test(target_ && (target_->*__arrFn)(pArr, maxSize, 0))) {
+							return replyError();
+						}
+					}
+					for (prot_size_t k = 0; k < count; k++) {
+						pArr[index + k] = ProtArrayRun<T>::at(first, step, k);
+					}
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
 			} else if (subCmd == SUBCMD_ARRAY_FINISHED) {
+				arrayPacking_ = ArrayPacking();
 				prot_size_t finalSize;
 				if (getValue(finalSize)) {
 					if (goodArray) {
@@ -1973,6 +3635,47 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		}
 
 
+		//-----------------------------------------------------------------------
+		// process set sequence
+		//-----------------------------------------------------------------------
+
+		/** Process a set sequence command into a ProtSequence generator program.
+		SUBCMD_ARRAY_SIZE starts a new program and SUBCMD_ARRAY_FINISHED rewinds it.
+		Takes an optional __afterSet task function that will be called
+		and checked once the whole program has arrived. @see AboutSubCommands */
+		template <typename T, prot_size_t N>
+		bool processSetSequence(prot_cmd_t __cmdSet, ProtSequence<T, N>& __seq, typename TaskFn::type __afterSet = 0) {
+			prot_cmd_t subCmd;
+			if (!getValue(subCmd)) {
+				return replyError();
+			}
+			if (subCmd == SUBCMD_ARRAY_SIZE) {
+				__seq.restart();
+				return test(reply(__cmdSet) && putValue(__seq.maxSize()));
+			} else if (subCmd == SUBCMD_SEQ_RAMP || subCmd == SUBCMD_SEQ_REPEAT) {
+				ProtSeqOp<T> op;
+				if (test(getSeqOp(subCmd, op) && __seq.append(op))) {
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
+			} else if (subCmd == SUBCMD_ARRAY_FINISHED) {
+				prot_size_t size;
+				if (test(getValue(size) && __seq.finish(size))) {
+					if (__afterSet) {
+						if (!test(target_ && (target_ ->* __afterSet)())) {
+							return replyError();
+						}
+					}
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
+			}
+			return replyError();
+		}
+
+
 		//-----------------------------------------------------------------------
 		// process get array
 		//-----------------------------------------------------------------------
@@ -2090,20 +3793,27 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 			maxSize = 0;
 			bool goodArray = test(getValue<prot_chan_t>(chan) && target_ && (target_->*__arrFn)(chan, pArr, maxSize, 0));
 
-			int subCmd;
-			if (!getValue<int>(subCmd)) {
+			prot_cmd_t subCmd;
+			if (!getValue(subCmd)) {
 				return replyError();
 			}
 			if (subCmd == SUBCMD_ARRAY_SIZE) {
+				arrayPacking_ = ArrayPacking();
 				if (goodArray) {
 					return test(reply(__cmdSet) && putValue(maxSize));
 				} else {
 					return replyError();
 				}
+			} else if (subCmd == SUBCMD_ARRAY_FORMAT) {
+				if (test(getArrayPacking<T>() && goodArray)) {
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
 			} else if (subCmd == SUBCMD_ARRAY_ELEMENT) {
 				prot_size_t index;
 				T el;
-				if (test(getValue(index) && getValue(el) && index < maxSize && goodArray)) {
+				if (test(getValue(index) && getArrayElement(el) && index < maxSize && goodArray)) {
 					if (index == 0) {
 						if (!test(target_ && (target_->*__arrFn)(chan, pArr, maxSize, 0))) {
 							return replyError();
@@ -2114,7 +3824,25 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 				} else {
 					return replyError();
 				}
+			} else if (subCmd == SUBCMD_ARRAY_RUN) {
+				prot_size_t index, count;
+				T first, step;
+				if (test(getValue(index) && getValue(count) && getValue(first) && getValue(step) 
+					&& index <= maxSize && count <= maxSize - index && goodArray)) {
+					if (index == 0) {
+						if (!test(target_ && (target_->*__arrFn)(chan, pArr, maxSize, 0))) {
+							return replyError();
+						}
+					}
+					for (prot_size_t k = 0; k < count; k++) {
+						pArr[index + k] = ProtArrayRun<T>::at(first, step, k);
+					}
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
 			} else if (subCmd == SUBCMD_ARRAY_FINISHED) {
+				arrayPacking_ = ArrayPacking();
 				prot_size_t finalSize;
 				if (getValue(finalSize)) {
 					if (goodArray) {
@@ -2131,6 +3859,54 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		}
 
 
+		//-----------------------------------------------------------------------
+		// process channel set sequence
+		//-----------------------------------------------------------------------
+
+		/** Process a set sequence command on a specific channel. __seqs holds one
+		ProtSequence per channel. The optional __afterSet task function is called
+		with the channel once its whole program has arrived. @see processSetSequence */
+		template <typename T, prot_size_t N>
+		bool processChannelSetSequence(prot_cmd_t __cmdSet, ProtSequence<T, N>* __seqs, prot_chan_t __numChans, 
+			typename ChannelTaskFn::type __afterSet = 0) {
+			prot_chan_t chan;
+			prot_cmd_t subCmd;
+			if (!test(getValue<prot_chan_t>(chan) && getValue(subCmd))) {
+				return replyError();
+			}
+			// arguments are still read for a bad channel
+			ProtSequence<T, N>* seq = (chan >= 0 && chan < __numChans) ? &__seqs[chan] : 0;
+			if (subCmd == SUBCMD_ARRAY_SIZE) {
+				if (seq) {
+					seq->restart();
+					return test(reply(__cmdSet) && putValue(seq->maxSize()));
+				} else {
+					return replyError();
+				}
+			} else if (subCmd == SUBCMD_SEQ_RAMP || subCmd == SUBCMD_SEQ_REPEAT) {
+				ProtSeqOp<T> op;
+				if (test(getSeqOp(subCmd, op) && seq && seq->append(op))) {
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
+			} else if (subCmd == SUBCMD_ARRAY_FINISHED) {
+				prot_size_t size;
+				if (test(getValue(size) && seq && seq->finish(size))) {
+					if (__afterSet) {
+						if (!test(target_ && (target_->*__afterSet)(chan))) {
+							return replyError();
+						}
+					}
+					return reply(__cmdSet);
+				} else {
+					return replyError();
+				}
+			}
+			return replyError();
+		}
+
+
 		//-----------------------------------------------------------------------
 		// process channel get array
 		//-----------------------------------------------------------------------
@@ -2188,6 +3964,221 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 
 
 
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Command tables, High-level
+		///
+		/// A command table replaces the big switch(__cmd) of a CommandFn. Each
+		/// entry pairs a command byte with a thunk, a static function that 
+		/// unpacks the command with the matching processXXX function. The 
+		/// handler member function is a template argument of the thunk, so the
+		/// entry itself holds only the command byte and one function pointer.
+		///
+		/// \code{.cpp}
+		/// class MyHandler : public StreamHexProtocol<MyHandler> {
+		/// public:
+		///		static const CommandEntry commands[];
+		///		bool doGetValue(uint16_t& __val);
+		///		bool doSetValue(const uint16_t __val);
+		///		bool doReset();
+		/// };
+		///
+		/// // sorted by command byte
+		/// const MyHandler::CommandEntry MyHandler::commands[] PROGMEM = {
+		///		{ GET_VALUE, &MyHandler::getEntry<uint16_t, &MyHandler::doGetValue> },
+		///		{ SET_VALUE, &MyHandler::setEntry<uint16_t, &MyHandler::doSetValue> },
+		///		{ RESET, &MyHandler::taskEntry<&MyHandler::doReset> },
+		/// };
+		///
+		/// void loop() {
+		///		if (handler.hasCommand()) {
+		///			handler.processCommand(handler.getCommand(), MyHandler::commands);
+		///		}
+		/// }
+		/// \endcode
+		///
+		/// The entries must be sorted by command byte. On the Arduino the table
+		/// must be declared PROGMEM. A table with consecutive command bytes is
+		/// looked up by index, any other table by binary search.
+		///
+		///@{
+
+		/** Thunk that unpacks one command for a command table entry.
+		@return true if the command succeeded */
+		struct CommandEntryFn {
+			typedef bool (*type)(DEV& __dev, prot_cmd_t __cmd);
+		};
+
+		/** One command table entry */
+		struct CommandEntry {
+			prot_cmd_t cmd;							///< command byte
+			typename CommandEntryFn::type handler;	///< thunk for the command
+		};
+
+		/** Entry for a CommandFn that does its own unpacking. */
+		template <typename CommandFn::type FN>
+		static bool commandEntry(DEV& __dev, prot_cmd_t __cmd) {
+			(__dev.*FN)(__cmd);
+			return true;
+		}
+
+		/** Entry for processTask() */
+		template <typename TaskFn::type FN>
+		static bool taskEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processTask(__cmd, FN);
+		}
+
+		/** Entry for processChannelTask() */
+		template <typename ChannelTaskFn::type FN>
+		static bool channelTaskEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processChannelTask(__cmd, FN);
+		}
+
+		/** Entry for processSet() with a SetValueFn */
+		template <typename T, typename SetValueFn<T>::type FN>
+		static bool setEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processSet<T>(__cmd, FN);
+		}
+
+		/** Entry for processChannelSet() with a ChannelSetValueFn */
+		template <typename T, typename ChannelSetValueFn<T>::type FN>
+		static bool channelSetEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processChannelSet<T>(__cmd, FN);
+		}
+
+		/** Entry for processGet() with a GetValueFn */
+		template <typename T, typename GetValueFn<T>::type FN>
+		static bool getEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processGet<T>(__cmd, FN);
+		}
+
+		/** Entry for processChannelGet() with a ChannelGetValueFn */
+		template <typename T, typename ChannelGetValueFn<T>::type FN>
+		static bool channelGetEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processChannelGet<T>(__cmd, FN);
+		}
+
+		/** Entry for processSetString() with a SetStringFn */
+		template <typename SetStringFn::type FN>
+		static bool setStringEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processSetString(__cmd, FN);
+		}
+
+		/** Entry for processChannelSetString() with a ChannelSetStringFn */
+		template <typename ChannelSetStringFn::type FN>
+		static bool channelSetStringEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processChannelSetString(__cmd, FN);
+		}
+
+		/** Entry for processGetString() with a GetStringFn */
+		template <typename GetStringFn::type FN>
+		static bool getStringEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processGetString(__cmd, FN);
+		}
+
+		/** Entry for processChannelGetString() with a ChannelGetStringFn */
+		template <typename ChannelGetStringFn::type FN>
+		static bool channelGetStringEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.processChannelGetString(__cmd, FN);
+		}
+
+		/** Entry for processSetArray() with a SetArrayFn */
+		template <typename T, typename SetArrayFn<T>::type FN>
+		static bool setArrayEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processSetArray<T>(__cmd, FN);
+		}
+
+		/** Entry for processGetArray() with a GetArrayFn */
+		template <typename T, typename GetArrayFn<T>::type FN>
+		static bool getArrayEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processGetArray<T>(__cmd, FN);
+		}
+
+		/** Entry for processChannelSetArray() with a ChannelSetArrayFn */
+		template <typename T, typename ChannelSetArrayFn<T>::type FN>
+		static bool channelSetArrayEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processChannelSetArray<T>(__cmd, FN);
+		}
+
+		/** Entry for processChannelGetArray() with a ChannelGetArrayFn */
+		template <typename T, typename ChannelGetArrayFn<T>::type FN>
+		static bool channelGetArrayEntry(DEV& __dev, prot_cmd_t __cmd) {
+			return __dev.template processChannelGetArray<T>(__cmd, FN);
+		}
+
+		/** True if the first __count entries of __table are strictly sorted by command 
+		byte. Usable in a static_assert when the table is constexpr. */
+		static constexpr bool commandsSorted(const CommandEntry* __table, size_t __count) {
+			return __count < 2 || (__table[0].cmd < __table[1].cmd && commandsSorted(__table + 1, __count - 1));
+		}
+
+		/** Find the thunk for __cmd in a sorted command table.
+		@return the thunk, or nullptr if __cmd is not in the table */
+		static typename CommandEntryFn::type findCommand(prot_cmd_t __cmd, const CommandEntry* __table, size_t __count) {
+			if (__count == 0) {
+				return nullptr;
+			}
+			// consecutive command bytes put __cmd at a known index
+			size_t index = static_cast<prot_cmd_t>(__cmd - readEntryCmd(__table));
+			if (index < __count && readEntryCmd(__table + index) == __cmd) {
+				return readEntryHandler(__table + index);
+			}
+			size_t lo = 0, hi = __count;
+			while (lo < hi) {
+				size_t mid = (lo + hi) / 2;
+				prot_cmd_t cmd = readEntryCmd(__table + mid);
+				if (cmd == __cmd) {
+					return readEntryHandler(__table + mid);
+				}
+				if (cmd < __cmd) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			return nullptr;
+		}
+
+		/** Command handling with a command table instead of a CommandFn. System commands 
+		are handled by processSystemCommand(), and commands missing from the table get
+		an error reply. Staged output is flushed once the command has been handled. */
+		void processCommand(prot_cmd_t __cmd, const CommandEntry* __table, size_t __count) {
+			if (!io().processSystemCommand(__cmd) && target_) {
+				typename CommandEntryFn::type handler = findCommand(__cmd, __table, __count);
+				if (handler) {
+					handler(*target_, __cmd);
+				} else {
+					replyError();
+				}
+			}
+			io().flushReply();
+		}
+
+		/** Command handling with a command table array. @see processCommand() */
+		template <size_t N>
+		void processCommand(prot_cmd_t __cmd, const CommandEntry (&__table)[N]) {
+			processCommand(__cmd, __table, N);
+		}
+
+	protected:
+		static prot_cmd_t readEntryCmd(const CommandEntry* __entry) {
+#ifdef __AVR__
+			return static_cast<prot_cmd_t>(pgm_read_byte(&__entry->cmd));
+#else
+			return __entry->cmd;
+#endif
+		}
+
+		static typename CommandEntryFn::type readEntryHandler(const CommandEntry* __entry) {
+#ifdef __AVR__
+			return reinterpret_cast<typename CommandEntryFn::type>(pgm_read_word(&__entry->handler));
+#else
+			return __entry->handler;
+#endif
+		}
+
 		///@}
 		/////////////////////////////////////////////////////////////////////////
 
@@ -2195,6 +4186,12 @@ inline char* prot_ftostr(float __val, char* __buf, size_t __size, unsigned char
 		DEV* target_; ///< Target device for processXXX commands
 		S stream_; ///< implementation-defined serial streaming device
 		bool started_ = false;
+		ProtocolCaps caps_;			///< capabilities shared by both sides this session
+		bool capsKnown_ = false;	///< has caps_ been negotiated this session?
+		bool syncPending_ = false;	///< slave: a PROT_SYNC arrived and must be answered
+		char syncNonce_[CODEC::INT_BUFF_SIZE];	///< slave: nonce of the pending PROT_SYNC
+		size_t syncNonceLen_ = 0;	///< slave: length of syncNonce_
+		ArrayPacking arrayPacking_;	///< slave: packing of the array being set
 	};
 
 }; // namespace hprot
@@ -0,0 +1,462 @@
+/**
+\ingroup	DeviceHexProtocol
+\file		ProtocolCapture.h
+\brief		Binary ring-buffer capture of HexProtocol transactions
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+/**
+\ingroup DeviceHexProtocol
+
+\page AboutProtocolCapture About Protocol Capture
+
+About Protocol Capture
+==========================
+
+The old LOG_DEVICE_HEX_PROTOCOL logging built an ostringstream and called
+LogMessage for every byte sent or received. That was far too slow to leave
+on in production. TransactionCapture replaces it with a fixed-size ring
+buffer of small binary records. Recording a send or receive is a clock read
+and a memcpy. Nothing is formatted until somebody asks for it.
+
+Each CaptureRecord holds a timestamp, a direction (command, send, receive)
+and up to PROT_CAPTURE_BYTES raw bytes. Longer payloads spill over into
+continuation records. Transactions are bracketed by CAPTURE_BEGIN and
+CAPTURE_END records, which DeviceHexProtocol writes from lockStream() and
+unlockStream().
+
+Rendering
+------------------------------------
+
+renderCapture() turns a list of records back into the familiar
+human-readable log format described in DeviceHexProtocol:
+
+\code
+	M=0x4d: [1f\x4] {4d\x4}
+\endcode
+
+getLastLog() simply renders the last complete transaction in the ring.
+
+Capture files
+------------------------------------
+
+TransactionCapture::dump() writes the ring to a compact binary file.
+Each record is stored as a direction byte, a length byte, a
+variable-length time delta in nanoseconds and the raw payload bytes.
+Use readCapture() and renderCapture() (or decodeCapture() for both at once)
+to turn a capture file back into text offline. The HexCaptureDecode tool
+is a thin command-line wrapper around decodeCapture().
+
+\code{.cpp}
+	// on the device
+	dumpCapture("C:\\temp\\arduino-hub.hpcap");
+
+	// offline
+	std::ifstream in("arduino-hub.hpcap", std::ios::binary);
+	hprot::decodeCapture(in, std::cout);
+	// +0.000ms  M=0x4d: [1f\x4] {4d\x4}
+	// +1.212ms  O=0x4f: {4f\x4} {1f\x4}
+\endcode
+*/
+
+#pragma once
+
+#include "HexProtocol.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace hprot {
+
+	//////////////////////////////////////////////////////////////////////////
+	/// \name Capture record layout
+	/// \ingroup	DeviceHexProtocol
+	///@{
+
+	/** Direction (kind) of a captured record */
+	enum CaptureDir : std::uint8_t {
+		CAPTURE_BEGIN = 0x00,		///< start of a transaction (lockStream)
+		CAPTURE_END = 0x01,			///< end of a transaction (unlockStream)
+		CAPTURE_CMD = 0x02,			///< single command byte sent with writeByte
+		CAPTURE_SEND = 0x03,		///< buffer sent with writeBuffer
+		CAPTURE_RECV = 0x04,		///< terminated answer received
+		CAPTURE_RECV_EMPTY = 0x05,	///< receive timed out or failed
+		CAPTURE_CONTINUED = 0x80	///< flag: payload continues the previous record
+	};
+
+	/** Maximum payload bytes held by a single capture record. Sized so a record is 32 bytes. */
+	const size_t PROT_CAPTURE_BYTES = 22;
+
+	/** A single captured send or receive. */
+	struct CaptureRecord {
+		std::uint64_t time;					///< nanoseconds on the steady clock
+		std::uint8_t dir;					///< CaptureDir, possibly or'ed with CAPTURE_CONTINUED
+		std::uint8_t len;					///< number of valid bytes
+		char bytes[PROT_CAPTURE_BYTES];		///< raw payload bytes
+	};
+
+	/** Magic number at the start of a capture file */
+	const char PROT_CAPTURE_MAGIC[8] = { 'H', 'P', 'C', 'A', 'P', '0', '1', '\0' };
+
+	///@}
+	//////////////////////////////////////////////////////////////////////////
+
+	/** Read the capture clock in nanoseconds.
+	\ingroup DeviceHexProtocol */
+	inline std::uint64_t captureClock() {
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/**
+	Fixed-size ring buffer of binary transaction records.
+
+	\ingroup DeviceHexProtocol
+
+	Recording never allocates and never formats. The oldest records are
+	silently overwritten once the ring is full. Writers reserve a slot with
+	a single atomic increment, so records from several threads will not
+	collide, although a reader (dump() or lastTransaction()) should be used
+	while the protocol is locked or idle to get a consistent picture.
+
+	@tparam N	number of records in the ring. Must be a power of two.
+	*/
+	template <size_t N>
+	class TransactionCapture {
+		static_assert(N > 0 && (N & (N - 1)) == 0, "TransactionCapture size must be a power of two");
+	public:
+		TransactionCapture() : seq_(0) { }
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Recording
+		///
+		///@{
+
+		/** Record a transaction start marker. */
+		void begin() {
+			record(CAPTURE_BEGIN, nullptr, 0);
+		}
+
+		/** Record a transaction end marker. */
+		void end() {
+			record(CAPTURE_END, nullptr, 0);
+		}
+
+		/** Record a payload, spilling into continuation records as needed. */
+		void record(std::uint8_t __dir, const char* __data, size_t __len) {
+			std::uint64_t now = captureClock();
+			do {
+				size_t chunk = __len < PROT_CAPTURE_BYTES ? __len : PROT_CAPTURE_BYTES;
+				CaptureRecord& rec = ring_[seq_.fetch_add(1, std::memory_order_relaxed) & (N - 1)];
+				rec.time = now;
+				rec.dir = __dir;
+				rec.len = static_cast<std::uint8_t>(chunk);
+				if (chunk) {
+					memcpy(rec.bytes, __data, chunk);
+				}
+				__data += chunk;
+				__len -= chunk;
+				__dir |= CAPTURE_CONTINUED;
+			} while (__len > 0);
+		}
+
+		/** Record a payload followed by its terminator character. */
+		void record(std::uint8_t __dir, const char* __data, size_t __len, char __terminator) {
+			if (__len < PROT_CAPTURE_BYTES) {
+				// common case: short token plus terminator fits in one record
+				char buf[PROT_CAPTURE_BYTES];
+				memcpy(buf, __data, __len);
+				buf[__len] = __terminator;
+				record(__dir, buf, __len + 1);
+			} else {
+				record(__dir, __data, __len);
+				record(static_cast<std::uint8_t>(__dir | CAPTURE_CONTINUED), &__terminator, 1);
+			}
+		}
+
+		/** Forget all records. */
+		void clear() {
+			seq_.store(0);
+		}
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/////////////////////////////////////////////////////////////////////////
+		/// \name Reading
+		///
+		///@{
+
+		/** Number of valid records currently in the ring. */
+		size_t size() const {
+			std::uint64_t seq = seq_.load();
+			return seq < N ? static_cast<size_t>(seq) : N;
+		}
+
+		/** Total number of records ever written. Use with at() to walk
+		the records written since an earlier sequence number. */
+		std::uint64_t sequence() const {
+			return seq_.load();
+		}
+
+		/** The record with sequence number __seq. Only the last N records are
+		still in the ring. */
+		const CaptureRecord& at(std::uint64_t __seq) const {
+			return ring_[__seq & (N - 1)];
+		}
+
+		/** Copy the records out of the ring, oldest first. */
+		std::vector<CaptureRecord> records() const {
+			std::uint64_t seq = seq_.load();
+			std::uint64_t first = seq < N ? 0 : seq - N;
+			std::vector<CaptureRecord> res;
+			res.reserve(static_cast<size_t>(seq - first));
+			for (std::uint64_t i = first; i < seq; i++) {
+				res.push_back(ring_[i & (N - 1)]);
+			}
+			return res;
+		}
+
+		/** Copy out the records of the last complete transaction,
+		from its CAPTURE_BEGIN up to and including its CAPTURE_END. */
+		std::vector<CaptureRecord> lastTransaction() const {
+			std::uint64_t seq = seq_.load();
+			std::uint64_t first = seq < N ? 0 : seq - N;
+			std::uint64_t end = seq;
+			// find the last end marker
+			while (end > first && ring_[(end - 1) & (N - 1)].dir != CAPTURE_END) {
+				end--;
+			}
+			if (end == first) {
+				return std::vector<CaptureRecord>();
+			}
+			// and its matching begin marker
+			std::uint64_t begin = end - 1;
+			while (begin > first && ring_[begin & (N - 1)].dir != CAPTURE_BEGIN) {
+				begin--;
+			}
+			std::vector<CaptureRecord> res;
+			for (std::uint64_t i = begin; i < end; i++) {
+				res.push_back(ring_[i & (N - 1)]);
+			}
+			return res;
+		}
+
+		/** Write the ring to a compact binary capture stream. @see readCapture() */
+		bool dump(std::ostream& __os) const {
+			std::vector<CaptureRecord> recs = records();
+			__os.write(PROT_CAPTURE_MAGIC, sizeof(PROT_CAPTURE_MAGIC));
+			std::uint64_t prev = recs.empty() ? 0 : recs.front().time;
+			writeCaptureUInt(__os, prev);
+			writeCaptureUInt(__os, recs.size());
+			for (const CaptureRecord& rec : recs) {
+				__os.put(static_cast<char>(rec.dir));
+				__os.put(static_cast<char>(rec.len));
+				writeCaptureUInt(__os, rec.time - prev);
+				__os.write(rec.bytes, rec.len);
+				prev = rec.time;
+			}
+			return __os.good();
+		}
+
+		///@}
+		/////////////////////////////////////////////////////////////////////////
+
+		/** Write a variable-length unsigned value, seven bits per byte. */
+		static void writeCaptureUInt(std::ostream& __os, std::uint64_t __val) {
+			do {
+				std::uint8_t b = __val & 0x7F;
+				__val >>= 7;
+				if (__val) {
+					b |= 0x80;
+				}
+				__os.put(static_cast<char>(b));
+			} while (__val);
+		}
+
+	protected:
+		CaptureRecord ring_[N];					///< the ring itself
+		std::atomic<std::uint64_t> seq_;		///< total number of records ever written
+	};
+
+	/////////////////////////////////////////////////////////////////////////
+	/// \name Offline decoding
+	/// \ingroup DeviceHexProtocol
+	///@{
+
+	/** Read a variable-length unsigned value written by TransactionCapture::writeCaptureUInt. */
+	inline bool readCaptureUInt(std::istream& __is, std::uint64_t& __val) {
+		__val = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			int c = __is.get();
+			if (c == EOF) {
+				return false;
+			}
+			__val |= static_cast<std::uint64_t>(c & 0x7F) << shift;
+			if (!(c & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** Read a capture stream written by TransactionCapture::dump(). */
+	inline bool readCapture(std::istream& __is, std::vector<CaptureRecord>& __records) {
+		char magic[sizeof(PROT_CAPTURE_MAGIC)];
+		if (!__is.read(magic, sizeof(magic)) || memcmp(magic, PROT_CAPTURE_MAGIC, sizeof(magic)) != 0) {
+			return false;
+		}
+		std::uint64_t time, count;
+		if (!readCaptureUInt(__is, time) || !readCaptureUInt(__is, count)) {
+			return false;
+		}
+		__records.clear();
+		for (std::uint64_t i = 0; i < count; i++) {
+			CaptureRecord rec;
+			std::uint64_t delta;
+			int dir = __is.get();
+			int len = __is.get();
+			if (dir == EOF || len == EOF || len > static_cast<int>(PROT_CAPTURE_BYTES) || !readCaptureUInt(__is, delta)) {
+				return false;
+			}
+			time += delta;
+			rec.time = time;
+			rec.dir = static_cast<std::uint8_t>(dir);
+			rec.len = static_cast<std::uint8_t>(len);
+			if (!__is.read(rec.bytes, len)) {
+				return false;
+			}
+			__records.push_back(rec);
+		}
+		return true;
+	}
+
+	/** Append bytes to a log string, showing control characters as `\\xN`. */
+	inline void renderCaptureBytes(std::ostream& __os, const char* __bytes, size_t __len) {
+		for (size_t i = 0; i < __len; i++) {
+			unsigned char c = static_cast<unsigned char>(__bytes[i]);
+			if (c < ASCII_MIN_TEXT || c > ASCII_MAX_TEXT) {
+				__os << "\\x" << std::hex << int(c) << std::dec;
+			} else {
+				__os << static_cast<char>(c);
+			}
+		}
+	}
+
+	/** Render records in the human-readable log format. One transaction per line.
+	@param __records records to render, oldest first
+	@param __os output stream
+	@param __showTime prefix each transaction with its time (ms) relative to the first record */
+	inline void renderCapture(const std::vector<CaptureRecord>& __records, std::ostream& __os, bool __showTime = false) {
+		std::uint64_t t0 = __records.empty() ? 0 : __records.front().time;
+		bool inTransaction = false;
+		bool hasCommand = false;
+		std::uint8_t open = 0;
+		// close any open bracket from a previous send or receive
+		auto close = [&]() {
+			if (open == CAPTURE_SEND) {
+				__os << "] ";
+			} else if (open == CAPTURE_RECV) {
+				__os << "} ";
+			}
+			open = 0;
+		};
+		for (const CaptureRecord& rec : __records) {
+			std::uint8_t dir = rec.dir & ~CAPTURE_CONTINUED;
+			bool continued = (rec.dir & CAPTURE_CONTINUED) != 0;
+			if (continued && dir == open) {
+				renderCaptureBytes(__os, rec.bytes, rec.len);
+				continue;
+			}
+			close();
+			if (!inTransaction && dir != CAPTURE_BEGIN && dir != CAPTURE_END) {
+				// records outside of a lockStream/unlockStream pair
+				inTransaction = true;
+				hasCommand = false;
+				if (__showTime) {
+					__os << "+" << (rec.time - t0) / 1000000.0 << "ms  ";
+				}
+			}
+			switch (dir) {
+			case CAPTURE_BEGIN:
+				if (inTransaction) {
+					__os << "\n";
+				}
+				inTransaction = true;
+				hasCommand = false;
+				if (__showTime) {
+					__os << "+" << (rec.time - t0) / 1000000.0 << "ms  ";
+				}
+				break;
+			case CAPTURE_END:
+				if (inTransaction) {
+					__os << "\n";
+				}
+				inTransaction = false;
+				break;
+			case CAPTURE_CMD:
+				if (rec.len > 0) {
+					if (hasCommand) {
+						// indicate end of last command with an @ symbol
+						__os << "@ ";
+					}
+					hasCommand = true;
+					unsigned char b = static_cast<unsigned char>(rec.bytes[0]);
+					renderCaptureBytes(__os, rec.bytes, 1);
+					__os << "=0x" << std::hex << int(b) << std::dec << ": ";
+				}
+				break;
+			case CAPTURE_SEND:
+				__os << "[";
+				renderCaptureBytes(__os, rec.bytes, rec.len);
+				open = CAPTURE_SEND;
+				break;
+			case CAPTURE_RECV:
+				__os << "{";
+				renderCaptureBytes(__os, rec.bytes, rec.len);
+				open = CAPTURE_RECV;
+				break;
+			case CAPTURE_RECV_EMPTY:
+				__os << "{empty} ";
+				break;
+			}
+		}
+		close();
+		if (inTransaction) {
+			__os << "\n";
+		}
+	}
+
+	/** Render a single transaction as one log string without the trailing newline. */
+	inline std::string renderTransaction(const std::vector<CaptureRecord>& __records) {
+		std::ostringstream os;
+		renderCapture(__records, os, false);
+		std::string res = os.str();
+		while (!res.empty() && (res.back() == '\n' || res.back() == ' ')) {
+			res.pop_back();
+		}
+		return res;
+	}
+
+	/** Decode a binary capture stream into the human-readable format with timestamps. */
+	inline bool decodeCapture(std::istream& __is, std::ostream& __os) {
+		std::vector<CaptureRecord> records;
+		if (!readCapture(__is, records)) {
+			return false;
+		}
+		renderCapture(records, __os, true);
+		return true;
+	}
+
+	///@}
+	/////////////////////////////////////////////////////////////////////////
+
+}; // namespace hprot
@@ -0,0 +1,514 @@
+/**
+\ingroup	DeviceHexProtocol
+\file		ProtocolReplay.h
+\brief		Replays captured HexProtocol sessions for throughput regression testing
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+/**
+\ingroup DeviceHexProtocol
+
+\page AboutProtocolReplay About Protocol Replay
+
+About Protocol Replay
+==========================
+
+Synthetic benchmark loops do not look like a real Micro-Manager session.
+The replay engine takes a session captured in production (see
+\ref AboutProtocolCapture) and plays the same command sequence, with the
+same idle gaps if desired, against a ReplayTransport. It reports the total
+wall time, per-command latency and the number of round trips.
+
+Sessions can be loaded from
+- a binary capture file written by DeviceHexProtocol::dumpCapture(), which
+  includes timing, or
+- one or more getLastLog() strings, which do not include timing.
+
+Transports
+------------------------------------
+
+- **EmulatedSlave** answers every read with the reply recorded in the session,
+  and times out where the session recorded a timeout. It can simulate the
+  wire time at a given baud rate and a fixed slave turnaround, which is
+  enough to compare protocol changes that alter the number of bytes or
+  round trips.
+
+Other targets, such as a serial port, implement ReplayTransport.
+
+Example
+------------------------------------
+
+\code{.cpp}
+	std::ifstream in("session.hpcap", std::ios::binary);
+	hprot::ReplaySession session;
+	if (!session.loadCapture(in)) {
+		return;
+	}
+	hprot::EmulatedSlave slave(session);
+	slave.withBaud(115200).withTurnaroundUs(200);
+
+	hprot::ReplayReport report = hprot::ReplayEngine().replay(session, slave);
+	report.print(std::cout);
+\endcode
+*/
+
+#pragma once
+
+#include "ProtocolCapture.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <thread>
+
+namespace hprot {
+
+	/////////////////////////////////////////////////////////////////////////
+	// ReplaySession
+	/////////////////////////////////////////////////////////////////////////
+
+	/** A single send or receive in a replayed session.
+	\ingroup DeviceHexProtocol */
+	struct ReplayToken {
+		std::uint8_t dir;		///< CAPTURE_CMD, CAPTURE_SEND, CAPTURE_RECV or CAPTURE_RECV_EMPTY
+		std::string bytes;		///< raw bytes, including the terminator on receives
+	};
+
+	/** One locked transaction of a replayed session.
+	\ingroup DeviceHexProtocol */
+	struct ReplayTransaction {
+		std::uint64_t time;					///< start time (ns), zero if unknown
+		std::vector<ReplayToken> tokens;	///< sends and receives in order
+	};
+
+	/**
+	A captured session: a list of transactions with their start times.
+
+	\ingroup DeviceHexProtocol
+	*/
+	class ReplaySession {
+	public:
+		/** Build the session from capture records. Continuation records are merged. */
+		void loadRecords(const std::vector<CaptureRecord>& __records) {
+			transactions_.clear();
+			bool inTransaction = false;
+			for (const CaptureRecord& rec : __records) {
+				std::uint8_t dir = rec.dir & ~CAPTURE_CONTINUED;
+				if (dir == CAPTURE_BEGIN) {
+					startTransaction(rec.time);
+					inTransaction = true;
+					continue;
+				}
+				if (dir == CAPTURE_END) {
+					inTransaction = false;
+					continue;
+				}
+				if (!inTransaction) {
+					// records sent outside of a StreamGuard
+					startTransaction(rec.time);
+					inTransaction = true;
+				}
+				std::vector<ReplayToken>& tokens = transactions_.back().tokens;
+				if ((rec.dir & CAPTURE_CONTINUED) && !tokens.empty() && tokens.back().dir == dir) {
+					tokens.back().bytes.append(rec.bytes, rec.len);
+				} else {
+					ReplayToken tok;
+					tok.dir = dir;
+					tok.bytes.assign(rec.bytes, rec.len);
+					tokens.push_back(tok);
+				}
+			}
+			dropEmpty();
+		}
+
+		/** Load a binary capture stream written by TransactionCapture::dump(). */
+		bool loadCapture(std::istream& __is) {
+			std::vector<CaptureRecord> records;
+			if (!readCapture(__is, records)) {
+				return false;
+			}
+			loadRecords(records);
+			return true;
+		}
+
+		/** Append a transaction from a getLastLog() string. Logs carry no timing, so
+		the transaction is replayed back-to-back with the previous one.
+		@return false if the log could not be parsed */
+		bool appendLog(const std::string& __log) {
+			startTransaction(0);
+			std::vector<ReplayToken>& tokens = transactions_.back().tokens;
+			size_t i = 0, n = __log.length();
+			while (i < n) {
+				char c = __log[i];
+				if (c == ' ' || c == '@' || c == '\n') {
+					i++;
+				} else if (c == '[' || c == '{') {
+					char close = (c == '[') ? ']' : '}';
+					size_t end = __log.find(close, i + 1);
+					if (end == std::string::npos) {
+						return false;
+					}
+					ReplayToken tok;
+					std::string body = __log.substr(i + 1, end - i - 1);
+					if (c == '{' && body == "empty") {
+						tok.dir = CAPTURE_RECV_EMPTY;
+					} else {
+						tok.dir = (c == '[') ? CAPTURE_SEND : CAPTURE_RECV;
+						tok.bytes = unescape(body);
+					}
+					tokens.push_back(tok);
+					i = end + 1;
+				} else {
+					// command: X=0xHH:
+					size_t eq = __log.find("=0x", i);
+					size_t colon = (eq == std::string::npos) ? eq : __log.find(':', eq);
+					if (colon == std::string::npos) {
+						return false;
+					}
+					ReplayToken tok;
+					tok.dir = CAPTURE_CMD;
+					tok.bytes.assign(1, static_cast<char>(strtoul(__log.substr(eq + 3, colon - eq - 3).c_str(), nullptr, 16)));
+					tokens.push_back(tok);
+					i = colon + 1;
+				}
+			}
+			dropEmpty();
+			return true;
+		}
+
+		/** The transactions in this session. */
+		const std::vector<ReplayTransaction>& transactions() const {
+			return transactions_;
+		}
+
+		/** All receives, including recorded timeouts, in session order. */
+		std::vector<const ReplayToken*> replies() const {
+			std::vector<const ReplayToken*> res;
+			for (const ReplayTransaction& trans : transactions_) {
+				for (const ReplayToken& tok : trans.tokens) {
+					if (tok.dir == CAPTURE_RECV || tok.dir == CAPTURE_RECV_EMPTY) {
+						res.push_back(&tok);
+					}
+				}
+			}
+			return res;
+		}
+
+		/** All tokens of a given direction, in session order. */
+		std::vector<const ReplayToken*> tokens(std::uint8_t __dir) const {
+			std::vector<const ReplayToken*> res;
+			for (const ReplayTransaction& trans : transactions_) {
+				for (const ReplayToken& tok : trans.tokens) {
+					if (tok.dir == __dir) {
+						res.push_back(&tok);
+					}
+				}
+			}
+			return res;
+		}
+
+	protected:
+		std::vector<ReplayTransaction> transactions_;
+
+		void startTransaction(std::uint64_t __time) {
+			dropEmpty();
+			ReplayTransaction trans;
+			trans.time = __time;
+			transactions_.push_back(trans);
+		}
+
+		void dropEmpty() {
+			if (!transactions_.empty() && transactions_.back().tokens.empty()) {
+				transactions_.pop_back();
+			}
+		}
+
+		/** Undo the `\\xN` escapes of renderCaptureBytes(). */
+		static std::string unescape(const std::string& __str) {
+			std::string res;
+			for (size_t i = 0; i < __str.length(); i++) {
+				if (__str[i] == '\\' && i + 2 < __str.length() && __str[i + 1] == 'x') {
+					size_t len = 0;
+					while (len < 2 && i + 2 + len < __str.length() && isxdigit(static_cast<unsigned char>(__str[i + 2 + len]))) {
+						len++;
+					}
+					if (len > 0) {
+						res.push_back(static_cast<char>(strtoul(__str.substr(i + 2, len).c_str(), nullptr, 16)));
+						i += 1 + len;
+						continue;
+					}
+				}
+				res.push_back(__str[i]);
+			}
+			return res;
+		}
+	};
+
+	/////////////////////////////////////////////////////////////////////////
+	// Transports
+	/////////////////////////////////////////////////////////////////////////
+
+	/**
+	Where the replay engine sends and receives its bytes.
+
+	\ingroup DeviceHexProtocol
+	*/
+	class ReplayTransport {
+	public:
+		virtual ~ReplayTransport() { }
+
+		/** Send raw bytes. */
+		virtual bool write(const char* __buffer, size_t __size) = 0;
+
+		/** Receive bytes up to and including the __terminator.
+		@return false on timeout */
+		virtual bool readUntil(char __terminator, std::string& __answer) = 0;
+
+		/** Called once before a replay starts. */
+		virtual void reset() { }
+	};
+
+	/**
+	A replay transport that answers every read with the reply recorded in the session.
+
+	\ingroup DeviceHexProtocol
+
+	A read where the session recorded a timeout returns false at once.
+	With no baud rate or turnaround set, the emulated slave answers
+	instantly and the replay measures host-side overhead only.
+	*/
+	class EmulatedSlave : public ReplayTransport {
+	public:
+		EmulatedSlave(const ReplaySession& __session) : replies_(__session.replies()) { }
+
+		/** Simulate the wire time of every byte at __baud (10 bits per byte). */
+		EmulatedSlave& withBaud(long __baud) {
+			baud_ = __baud;
+			return *this;
+		}
+
+		/** Simulate a fixed slave processing time before each reply. */
+		EmulatedSlave& withTurnaroundUs(long __us) {
+			turnaroundUs_ = __us;
+			return *this;
+		}
+
+		void reset() override {
+			next_ = 0;
+		}
+
+		bool write(const char*, size_t __size) override {
+			wait(wireUs(__size));
+			return true;
+		}
+
+		bool readUntil(char, std::string& __answer) override {
+			if (next_ >= replies_.size() || replies_[next_]->dir == CAPTURE_RECV_EMPTY) {
+				next_++;
+				return false;
+			}
+			__answer = replies_[next_++]->bytes;
+			wait(turnaroundUs_ + wireUs(__answer.length()));
+			return true;
+		}
+
+	protected:
+		std::vector<const ReplayToken*> replies_;
+		size_t next_ = 0;
+		long baud_ = 0;
+		long turnaroundUs_ = 0;
+
+		long wireUs(size_t __bytes) const {
+			return baud_ > 0 ? static_cast<long>(__bytes * 10 * 1000000LL / baud_) : 0;
+		}
+
+		static void wait(long __us) {
+			if (__us > 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(__us));
+			}
+		}
+	};
+
+	/////////////////////////////////////////////////////////////////////////
+	// ReplayEngine
+	/////////////////////////////////////////////////////////////////////////
+
+	/** Latency statistics for one command byte.
+	\ingroup DeviceHexProtocol */
+	struct ReplayLatency {
+		std::uint64_t count = 0;			///< number of times the command was sent
+		std::uint64_t totalNs = 0;			///< sum of latencies
+		std::uint64_t minNs = ~std::uint64_t(0);	///< fastest command
+		std::uint64_t maxNs = 0;			///< slowest command
+
+		void add(std::uint64_t __ns) {
+			count++;
+			totalNs += __ns;
+			minNs = __ns < minNs ? __ns : minNs;
+			maxNs = __ns > maxNs ? __ns : maxNs;
+		}
+
+		double meanUs() const {
+			return count ? totalNs / 1000.0 / count : 0;
+		}
+	};
+
+	/** Results of a replay.
+	\ingroup DeviceHexProtocol */
+	struct ReplayReport {
+		std::uint64_t wallNs = 0;			///< total wall time of the replay
+		std::uint64_t idleNs = 0;			///< time spent reproducing recorded idle gaps
+		std::uint64_t transactions = 0;		///< transactions replayed
+		std::uint64_t commands = 0;			///< command bytes sent
+		std::uint64_t roundTrips = 0;		///< number of send-to-receive turnarounds
+		std::uint64_t bytesSent = 0;		///< total bytes written
+		std::uint64_t bytesReceived = 0;	///< total bytes read
+		std::uint64_t failures = 0;			///< reads that timed out where the recording had a reply
+		std::uint64_t timeouts = 0;			///< reads that timed out as recorded
+		std::uint64_t mismatches = 0;		///< reads that differed from the recording
+		std::map<prot_cmd_t, ReplayLatency> latency;	///< per-command latency
+
+		/** Print a human-readable summary. */
+		void print(std::ostream& __os) const {
+			__os << std::fixed << std::setprecision(3)
+				<< "wall time:     " << wallNs / 1.0e6 << " ms"
+				<< " (busy " << (wallNs - idleNs) / 1.0e6 << " ms)\n"
+				<< "transactions:  " << transactions << "\n"
+				<< "commands:      " << commands << "\n"
+				<< "round trips:   " << roundTrips << "\n"
+				<< "bytes sent:    " << bytesSent << "\n"
+				<< "bytes recv:    " << bytesReceived << "\n"
+				<< "failures:      " << failures << "\n"
+				<< "timeouts:      " << timeouts << "\n"
+				<< "mismatches:    " << mismatches << "\n"
+				<< "command   count     mean(us)      min(us)      max(us)\n";
+			for (const auto& it : latency) {
+				__os << "  0x" << std::hex << std::setw(2) << std::setfill('0') << int(it.first)
+					<< std::dec << std::setfill(' ')
+					<< std::setw(10) << it.second.count
+					<< std::setw(13) << it.second.meanUs()
+					<< std::setw(13) << it.second.minNs / 1000.0
+					<< std::setw(13) << it.second.maxNs / 1000.0 << "\n";
+			}
+		}
+	};
+
+	/**
+	Plays a ReplaySession against a ReplayTransport.
+
+	\ingroup DeviceHexProtocol
+
+	Command latency is measured from the command byte to the last receive
+	before the next command byte. A read that times out where the session
+	recorded a timeout counts as a timeout, not a failure. A read that
+	answers where the session recorded a timeout is a mismatch.
+	*/
+	class ReplayEngine {
+	public:
+		/** Reproduce the idle gaps recorded between transactions (default false).
+		Only sessions loaded from capture files have timing. */
+		ReplayEngine& withRecordedTiming(bool __flag = true) {
+			recordedTiming_ = __flag;
+			return *this;
+		}
+
+		/** Stop the replay at the first read that fails (default false). */
+		ReplayEngine& withStopOnFailure(bool __flag = true) {
+			stopOnFailure_ = __flag;
+			return *this;
+		}
+
+		/** Replay __session over __transport. */
+		ReplayReport replay(const ReplaySession& __session, ReplayTransport& __transport) const {
+			typedef std::chrono::steady_clock clock;
+			ReplayReport report;
+			__transport.reset();
+			const std::vector<ReplayTransaction>& trans = __session.transactions();
+			clock::time_point start = clock::now();
+			std::uint64_t prevTime = trans.empty() ? 0 : trans.front().time;
+			clock::time_point prevStart = start;
+
+			for (const ReplayTransaction& t : trans) {
+				if (recordedTiming_ && t.time > prevTime) {
+					// wait out the recorded gap between transaction starts
+					clock::time_point due = prevStart + std::chrono::nanoseconds(t.time - prevTime);
+					clock::time_point now = clock::now();
+					if (due > now) {
+						std::this_thread::sleep_until(due);
+						report.idleNs += nanos(clock::now() - now);
+					}
+				}
+				prevTime = t.time;
+				prevStart = clock::now();
+				report.transactions++;
+
+				bool haveCmd = false;
+				bool lastWasSend = false;
+				prot_cmd_t cmd = 0;
+				clock::time_point cmdStart, lastRecv;
+				auto finishCmd = [&]() {
+					if (haveCmd) {
+						report.latency[cmd].add(nanos(lastRecv - cmdStart));
+					}
+				};
+				for (const ReplayToken& tok : t.tokens) {
+					if (tok.dir == CAPTURE_CMD || tok.dir == CAPTURE_SEND) {
+						if (tok.dir == CAPTURE_CMD && !tok.bytes.empty()) {
+							finishCmd();
+							haveCmd = true;
+							cmd = static_cast<prot_cmd_t>(tok.bytes[0]);
+							cmdStart = lastRecv = clock::now();
+							report.commands++;
+						}
+						__transport.write(tok.bytes.data(), tok.bytes.length());
+						report.bytesSent += tok.bytes.length();
+						lastWasSend = true;
+					} else {
+						if (lastWasSend) {
+							report.roundTrips++;
+						}
+						lastWasSend = false;
+						std::string answer;
+						char term = tok.bytes.empty() ? static_cast<char>(PROT_TERM_CHAR) : tok.bytes.back();
+						bool ok = __transport.readUntil(term, answer);
+						lastRecv = clock::now();
+						report.bytesReceived += answer.length();
+						if (tok.dir == CAPTURE_RECV_EMPTY) {
+							if (ok) {
+								report.mismatches++;
+							} else {
+								report.timeouts++;
+							}
+						} else if (!ok) {
+							report.failures++;
+							if (stopOnFailure_) {
+								finishCmd();
+								report.wallNs = nanos(clock::now() - start);
+								return report;
+							}
+						} else if (answer != tok.bytes) {
+							report.mismatches++;
+						}
+					}
+				}
+				finishCmd();
+			}
+			report.wallNs = nanos(clock::now() - start);
+			return report;
+		}
+
+	protected:
+		bool recordedTiming_ = false;
+		bool stopOnFailure_ = false;
+
+		template <class DUR>
+		static std::uint64_t nanos(DUR __d) {
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(__d).count());
+		}
+	};
+
+}; // namespace hprot
@@ -0,0 +1,239 @@
+/**
+\ingroup	DeviceHexProtocol
+\file		ProtocolTrace.h
+\brief		Chrome trace-event export of HexProtocol transactions
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+/**
+\ingroup DeviceHexProtocol
+
+\page AboutProtocolTrace About Protocol Tracing
+
+About Protocol Tracing
+==========================
+
+Micro-Manager's acquisition thread, the GUI thread and scripts all talk to
+the same hub. When they collide, each one waits on the hub's stream lock.
+Text logs cannot show this well. Tracing records timed spans that can be
+viewed on a timeline in \c chrome://tracing or https://ui.perfetto.dev
+
+\c \#define TRACE_DEVICE_HEX_PROTOCOL before \c \#include "DeviceHexProtocol.h"
+to compile tracing in. Call DeviceHexProtocol::startTrace() to start recording
+and DeviceHexProtocol::writeTrace() to save the JSON file.
+
+Three kinds of spans are recorded, each on the thread that caused it:
+
+| category      | span                                | args                             |
+|---------------|-------------------------------------|----------------------------------|
+| \c transaction | one outermost StreamGuard transaction | first command, number of commands, channel, bytes sent and received |
+| \c lock        | time spent waiting for the stream lock | none                          |
+| \c property    | one RemotePropBase::OnExecute call   | property action                  |
+
+Lock waits shorter than TRACE_DEVICE_HEX_PROTOCOL_MIN_WAIT_US are not recorded.
+*/
+
+#pragma once
+
+#include "ProtocolCapture.h"
+
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+/** \ingroup	DeviceHexProtocol
+Maximum number of trace events kept. The oldest events are dropped first. */
+#ifndef TRACE_DEVICE_HEX_PROTOCOL_EVENTS
+#define TRACE_DEVICE_HEX_PROTOCOL_EVENTS	65536
+#endif
+
+/** \ingroup	DeviceHexProtocol
+Shortest lock wait (in microseconds) recorded as a span. */
+#ifndef TRACE_DEVICE_HEX_PROTOCOL_MIN_WAIT_US
+#define TRACE_DEVICE_HEX_PROTOCOL_MIN_WAIT_US	10
+#endif
+
+namespace hprot {
+
+	/** A single complete ("X" phase) trace span.
+	\ingroup DeviceHexProtocol */
+	struct TraceEvent {
+		std::string name;			///< span name shown on the timeline
+		const char* cat;			///< category: "transaction", "lock" or "property"
+		std::uint64_t start;		///< start time (ns, capture clock)
+		std::uint64_t dur;			///< duration (ns)
+		std::uint32_t tid;			///< small thread number assigned by TraceRecorder
+		int cmd;					///< first command byte or -1
+		long chan;					///< channel or -1
+		std::uint32_t commands;		///< commands sent in the transaction
+		std::uint32_t sent;			///< bytes sent
+		std::uint32_t recv;			///< bytes received
+		const char* action;			///< property action or nullptr
+
+		TraceEvent() : cat(""), start(0), dur(0), tid(0), cmd(-1), chan(-1),
+			commands(0), sent(0), recv(0), action(nullptr) { }
+	};
+
+	/**
+	Collects trace spans from any thread and writes them as Chrome trace-event JSON.
+
+	\ingroup DeviceHexProtocol
+
+	Spans are only kept while the recorder is enabled. Adding a span takes a
+	mutex, but only once per transaction, lock wait or property action.
+	*/
+	class TraceRecorder {
+	public:
+		TraceRecorder() : enabled_(false) { }
+
+		/** Start or stop recording. */
+		void enable(bool __enabled = true) {
+			enabled_.store(__enabled);
+		}
+
+		/** True while recording. */
+		bool enabled() const {
+			return enabled_.load(std::memory_order_relaxed);
+		}
+
+		/** Add a completed span. The thread id is filled in from the calling thread. */
+		void add(TraceEvent& __event) {
+			if (!enabled()) {
+				return;
+			}
+			std::lock_guard<std::mutex> guard(mutex_);
+			std::thread::id id = std::this_thread::get_id();
+			std::map<std::thread::id, std::uint32_t>::const_iterator it = threads_.find(id);
+			__event.tid = (it == threads_.end()) ? (threads_[id] = static_cast<std::uint32_t>(threads_.size() + 1)) : it->second;
+			if (events_.size() >= TRACE_DEVICE_HEX_PROTOCOL_EVENTS) {
+				events_.pop_front();
+			}
+			events_.push_back(__event);
+		}
+
+		/** Forget all spans. */
+		void clear() {
+			std::lock_guard<std::mutex> guard(mutex_);
+			events_.clear();
+		}
+
+		/** Number of spans recorded. */
+		size_t size() const {
+			std::lock_guard<std::mutex> guard(mutex_);
+			return events_.size();
+		}
+
+		/** Write the spans as a Chrome trace-event JSON object. */
+		bool writeJson(std::ostream& __os) const {
+			std::lock_guard<std::mutex> guard(mutex_);
+			std::uint64_t origin = events_.empty() ? 0 : events_.front().start;
+			for (const TraceEvent& ev : events_) {
+				origin = ev.start < origin ? ev.start : origin;
+			}
+			__os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			bool first = true;
+			for (const auto& th : threads_) {
+				__os << (first ? "\n" : ",\n")
+					<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << th.second
+					<< ",\"args\":{\"name\":\"thread " << th.second << "\"}}";
+				first = false;
+			}
+			__os << std::fixed << std::setprecision(3);
+			for (const TraceEvent& ev : events_) {
+				__os << (first ? "\n" : ",\n") << "{\"name\":";
+				writeJsonString(__os, ev.name);
+				__os << ",\"cat\":\"" << ev.cat << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ev.tid
+					<< ",\"ts\":" << (ev.start - origin) / 1000.0
+					<< ",\"dur\":" << ev.dur / 1000.0
+					<< ",\"args\":{";
+				bool firstArg = true;
+				if (ev.cmd >= 0) {
+					__os << "\"cmd\":" << ev.cmd << ",\"commands\":" << ev.commands;
+					firstArg = false;
+				}
+				if (ev.chan >= 0) {
+					__os << (firstArg ? "" : ",") << "\"chan\":" << ev.chan;
+					firstArg = false;
+				}
+				if (ev.sent || ev.recv) {
+					__os << (firstArg ? "" : ",") << "\"sent\":" << ev.sent << ",\"recv\":" << ev.recv;
+					firstArg = false;
+				}
+				if (ev.action) {
+					__os << (firstArg ? "" : ",") << "\"action\":\"" << ev.action << "\"";
+				}
+				__os << "}}";
+				first = false;
+			}
+			__os << "\n]}\n";
+			return __os.good();
+		}
+
+	protected:
+		static void writeJsonString(std::ostream& __os, const std::string& __str) {
+			__os << '"';
+			for (char c : __str) {
+				if (c == '"' || c == '\\') {
+					__os << '\\' << c;
+				} else if (static_cast<unsigned char>(c) < 0x20) {
+					__os << "\\u00" << std::hex << std::setw(2) << std::setfill('0')
+						<< static_cast<int>(c) << std::dec << std::setfill(' ');
+				} else {
+					__os << c;
+				}
+			}
+			__os << '"';
+		}
+
+		std::atomic<bool> enabled_;
+		mutable std::mutex mutex_;
+		std::deque<TraceEvent> events_;
+		std::map<std::thread::id, std::uint32_t> threads_;
+	};
+
+	/**
+	Records a span from construction to destruction.
+
+	\ingroup DeviceHexProtocol
+	\code{.cpp}
+		{
+			hprot::TraceSpan span(pProto_->traceRecorder(), "property", name(), "AfterSet");
+			// ... work ...
+		} // span recorded here
+	\endcode
+	*/
+	class TraceSpan {
+	public:
+		/** A null or disabled __recorder makes the span a no-op. */
+		TraceSpan(TraceRecorder* __recorder, const char* __cat, const char* __name, const char* __action = nullptr)
+			: recorder_(__recorder && __recorder->enabled() ? __recorder : nullptr) {
+			if (recorder_) {
+				event_.cat = __cat;
+				event_.name = __name ? __name : "";
+				event_.action = __action;
+				event_.start = captureClock();
+			}
+		}
+
+		~TraceSpan() {
+			if (recorder_) {
+				event_.dur = captureClock() - event_.start;
+				recorder_->add(event_);
+			}
+		}
+
+	protected:
+		TraceRecorder* recorder_;
+		TraceEvent event_;
+	};
+
+}; // namespace hprot
@@ -60,9 +60,12 @@ types of remote properties.
 #pragma once
 
 #include "HexProtocol.h"
+#include "CommandSchema.h"
 #include "DeviceHexProtocol.h"
 #include "DeviceProp.h"
 #include "DeviceError.h"
+#include "SequenceGenerator.h"
+#include <limits>
 #include <regex>
 
 namespace dprop {
@@ -134,6 +137,41 @@ namespace dprop {
 			return *this;
 		}
 
+		/** Fixed answer timeout for all commands in the set, for slow tasks 
+		such as homing. 0 uses the adaptive timeout. 
+		@see hprot::DeviceHexProtocol::setCommandTimeout */
+		CommandSet& withTimeout(long __timeoutMs) {
+			timeoutMs_ = __timeoutMs;
+			return *this;
+		}
+
+		/** Send float sequence elements as IEEE-754 halves, about 3 significant
+		digits, if the slave can expand them.
+		@see hprot::ARRAY_FORMAT_HALF */
+		CommandSet& withSeqHalf() {
+			seqFormat_ = hprot::ARRAY_FORMAT_HALF;
+			return *this;
+		}
+
+		/** Send float sequence elements as __bits-bit steps between the property 
+		limits, if the slave can expand them. Needs a PropInfo with limits.
+		__bits must be 1..31. @see hprot::ARRAY_FORMAT_FIXED */
+		CommandSet& withSeqFixedPoint(int __bits) {
+			assert(__bits >= 1 && __bits <= 31);
+			seqFormat_ = hprot::ARRAY_FORMAT_FIXED;
+			seqBits_ = __bits;
+			return *this;
+		}
+
+		/** The slave keeps the sequence as a generator program and handles the 
+		set sequence command with hprot::HexProtocolBase::processSetSequence. 
+		Sequences are uploaded as ramps and repeats instead of values.
+		@see SequenceGenerator */
+		CommandSet& withSeqGenerator() {
+			seqGenerator_ = true;
+			return *this;
+		}
+
 		hprot::prot_cmd_t cmdGet() const {
 			return get_;
 		}
@@ -170,6 +208,22 @@ namespace dprop {
 			return chan_;
 		}
 
+		long timeoutMs() const {
+			return timeoutMs_;
+		}
+
+		hprot::prot_byte_t seqFormat() const {
+			return seqFormat_;
+		}
+
+		int seqBits() const {
+			return seqBits_;
+		}
+
+		bool seqGenerator() const {
+			return seqGenerator_;
+		}
+
 	protected:
 		template <typename T, class DEV, class HUB>
 		friend class RemotePropBase;
@@ -185,6 +239,149 @@ namespace dprop {
 		hprot::prot_cmd_t task_ = 0;
 		hprot::prot_chan_t chan_ = 0;
 		bool hasChan_ = false;
+		long timeoutMs_ = 0;
+		hprot::prot_byte_t seqFormat_ = hprot::ARRAY_FORMAT_NATIVE;
+		int seqBits_ = 0;
+		bool seqGenerator_ = false;
+	};
+
+	/** CommandSet built from the typed descriptors of a command schema.
+
+	\ingroup RemoteProp
+
+	Each withXXX<D>() checks at compile time that the descriptor D is the right
+	kind of command and carries T, so host and slave cannot disagree on the 
+	command byte or its type. The host sends every command in a set with or 
+	without the channel, so whether the set uses a channel is part of its type,
+	and every descriptor must agree with it.
+	\code{.cpp}
+	TypedCommandSet<uint16_t> cmds = TypedCommandSet<uint16_t>::build()
+		.withSet<mycmd::SetValue>().withGet<mycmd::GetValue>();
+	prop.createRemoteProp(device, protocol, propInfo, cmds);
+	\endcode
+
+	@see \ref AboutCommandSchema
+	@tparam T		property type, or the element type of a RemoteArrayProp
+	@tparam CHAN	true for a set of channel commands, built with a channel number
+	*/
+	template <typename T, bool CHAN = false>
+	class TypedCommandSet : public CommandSet {
+	public:
+		static TypedCommandSet build() {
+			static_assert(!CHAN, "a channel command set needs a channel");
+			return TypedCommandSet();
+		}
+
+		static TypedCommandSet build(hprot::prot_chan_t __chan) {
+			static_assert(CHAN, "only a channel command set takes a channel");
+			TypedCommandSet cmds;
+			cmds.withChan(__chan);
+			return cmds;
+		}
+
+		/** Set command. May be a value, string or array command. */
+		template <class D>
+		TypedCommandSet& withSet() {
+			static_assert(D::kind == hprot::CMD_KIND_SET || D::kind == hprot::CMD_KIND_SET_STRING
+				|| D::kind == hprot::CMD_KIND_SET_ARRAY, "withSet needs a set command");
+			checkType<D>();
+			set_ = D::cmd;
+			return *this;
+		}
+
+		/** Get command. May be a value, string or array command. */
+		template <class D>
+		TypedCommandSet& withGet() {
+			static_assert(D::kind == hprot::CMD_KIND_GET || D::kind == hprot::CMD_KIND_GET_STRING
+				|| D::kind == hprot::CMD_KIND_GET_ARRAY, "withGet needs a get command");
+			checkType<D>();
+			get_ = D::cmd;
+			return *this;
+		}
+
+		template <class D>
+		TypedCommandSet& withSetSeq() {
+			static_assert(D::kind == hprot::CMD_KIND_SET_ARRAY, "withSetSeq needs a set array command");
+			checkType<D>();
+			setSeq_ = D::cmd;
+			return *this;
+		}
+
+		template <class D>
+		TypedCommandSet& withGetSeq() {
+			static_assert(D::kind == hprot::CMD_KIND_GET_ARRAY, "withGetSeq needs a get array command");
+			checkType<D>();
+			getSeq_ = D::cmd;
+			return *this;
+		}
+
+		template <class D>
+		TypedCommandSet& withStartSeq() {
+			static_assert(D::kind == hprot::CMD_KIND_TASK, "withStartSeq needs a task command");
+			checkChan<D>();
+			startSeq_ = D::cmd;
+			return *this;
+		}
+
+		template <class D>
+		TypedCommandSet& withStopSeq() {
+			static_assert(D::kind == hprot::CMD_KIND_TASK, "withStopSeq needs a task command");
+			checkChan<D>();
+			stopSeq_ = D::cmd;
+			return *this;
+		}
+
+		template <class D>
+		TypedCommandSet& withTask() {
+			static_assert(D::kind == hprot::CMD_KIND_TASK, "withTask needs a task command");
+			checkChan<D>();
+			task_ = D::cmd;
+			return *this;
+		}
+
+		/** Fixed answer timeout for all commands in the set. @see CommandSet::withTimeout */
+		TypedCommandSet& withTimeout(long __timeoutMs) {
+			CommandSet::withTimeout(__timeoutMs);
+			return *this;
+		}
+
+		/** Half-precision sequence elements. @see CommandSet::withSeqHalf */
+		TypedCommandSet& withSeqHalf() {
+			static_assert(std::is_floating_point<T>::value, "only float sequences can be packed");
+			CommandSet::withSeqHalf();
+			return *this;
+		}
+
+		/** Fixed-point sequence elements. @see CommandSet::withSeqFixedPoint */
+		TypedCommandSet& withSeqFixedPoint(int __bits) {
+			static_assert(std::is_floating_point<T>::value, "only float sequences can be packed");
+			CommandSet::withSeqFixedPoint(__bits);
+			return *this;
+		}
+
+		/** Generator program sequences. @see CommandSet::withSeqGenerator */
+		TypedCommandSet& withSeqGenerator() {
+			CommandSet::withSeqGenerator();
+			return *this;
+		}
+
+	protected:
+		TypedCommandSet() {}
+
+		// the channel is given to build()
+		using CommandSet::withChan;
+
+		template <class D>
+		void checkType() {
+			static_assert(hprot::SchemaSameType<typename D::value_type, T>::value, 
+				"command value type does not match the property type");
+			checkChan<D>();
+		}
+
+		template <class D>
+		void checkChan() {
+			static_assert(D::channel == CHAN, "channel commands need a TypedCommandSet<T, true> and plain ones a TypedCommandSet<T>");
+		}
 	};
 
 	/////////////////////////////////////////////////////////////////////////////
@@ -221,10 +418,12 @@ namespace dprop {
 	protected:
 		typedef MM::Action<RemotePropBase<T, DEV, HUB>> ActionType;
 
-		RemotePropBase() : pProto_(nullptr) { }
+		RemotePropBase() : pProto_(nullptr), linkEpoch_(0) { }
 
 		CommandSet cmds_;
 		ProtocolClass* pProto_;
+		unsigned linkEpoch_;	///< pProto_->linkEpoch() when the remote last had our value
+		hprot::ArrayPacking seqPacking_;	///< packing of sequence elements sent with cmdSetSeq
 
 		virtual ~RemotePropBase() { }
 
@@ -235,6 +434,17 @@ namespace dprop {
 		int createRemotePropH(DEV* __pDevice, ProtocolClass* __pProtocol, const PropInfo<T>& __propInfo, CommandSet& __cmdSet) {
 			pProto_ = __pProtocol;
 			cmds_ = __cmdSet;
+			linkEpoch_ = pProto_->linkEpoch();
+			seqPacking_ = seqPackingH(__propInfo);
+			if (cmds_.timeoutMs() > 0) {
+				const hprot::prot_cmd_t cmds[] = { cmds_.cmdSet(), cmds_.cmdGet(), cmds_.cmdSetSeq(), 
+					cmds_.cmdGetSeq(), cmds_.cmdStartSeq(), cmds_.cmdStopSeq(), cmds_.cmdTask() };
+				for (hprot::prot_cmd_t cmd : cmds) {
+					if (cmd) {
+						pProto_->setCommandTimeout(cmd, cmds_.timeoutMs());
+					}
+				}
+			}
 			int ret;
 			bool readOnly = cmds_.cmdSet() == 0;
 			bool useInitialValue = false;
@@ -260,6 +470,22 @@ namespace dprop {
 			return DEVICE_OK;
 		}
 
+		/* Helper function to choose how sequence elements are packed. Only float
+		sequences are packed, and fixed-point packing needs the property limits. */
+		hprot::ArrayPacking seqPackingH(const PropInfo<T>& __propInfo) const {
+			if (!std::is_floating_point<T>::value) {
+				return hprot::ArrayPacking();
+			}
+			if (cmds_.seqFormat() == hprot::ARRAY_FORMAT_HALF) {
+				return hprot::ArrayPacking::half();
+			}
+			if (cmds_.seqFormat() == hprot::ARRAY_FORMAT_FIXED && __propInfo.hasLimits()) {
+				return hprot::ArrayPacking::fixed(static_cast<hprot::prot_float_t>(__propInfo.minValue()), 
+					static_cast<hprot::prot_float_t>(__propInfo.maxValue()), cmds_.seqBits());
+			}
+			return hprot::ArrayPacking();
+		}
+
 		/* Helper function to retreive an array from the device.
 		It is up the caller to pass the correct __getCmd. */
 		template <typename E>
@@ -340,9 +566,11 @@ namespace dprop {
 		}
 
 		/* Helper function put put an array on the remote device.
-		It is up the caller to pass the correct __setCmd. */
+		It is up the caller to pass the correct __setCmd. Float elements
+		are packed with __packing if the remote can expand them. */
 		template <typename E>
-		bool putRemoteArrayH(const hprot::prot_cmd_t __setCmd, const std::vector<E> __array, hprot::prot_size_t __remoteMaxSeqSize) {
+		bool putRemoteArrayH(const hprot::prot_cmd_t __setCmd, const std::vector<E> __array, hprot::prot_size_t __remoteMaxSeqSize, 
+			const hprot::ArrayPacking& __packing = hprot::ArrayPacking()) {
 			typename ProtocolClass::StreamGuard monitor(pProto_);
 			// NOTE: the __remoteMaxSeqSize argument is mainly there to insure that we have
 			// already called getRemoteMaxSeqSize().
@@ -352,9 +580,9 @@ namespace dprop {
 			}
 			// Send the values
 			if (cmds_.hasChan()) {
-				return __setCmd && pProto_->dispatchChannelSetArray(__setCmd, cmds_.cmdChan() , __array.data(), size);
+				return __setCmd && pProto_->dispatchChannelSetArray(__setCmd, cmds_.cmdChan() , __array.data(), size, __packing);
 			} else {
-				return __setCmd && pProto_->dispatchSetArray(__setCmd, __array.data(), size);
+				return __setCmd && pProto_->dispatchSetArray(__setCmd, __array.data(), size, __packing);
 			}
 		}
 
@@ -363,7 +591,8 @@ namespace dprop {
 		mast have alread used getRemoteArrayMaxSizeH to get the maximum size and
 		placed the value in __remoteMaxSeqSize. */
 		template <typename E>
-		bool putRemoteStringArrayH(const hprot::prot_cmd_t __setCmd, const std::vector<std::string> __strArray, hprot::prot_size_t __remoteMaxSeqSize) {
+		bool putRemoteStringArrayH(const hprot::prot_cmd_t __setCmd, const std::vector<std::string> __strArray, hprot::prot_size_t __remoteMaxSeqSize, 
+			const hprot::ArrayPacking& __packing = hprot::ArrayPacking()) {
 			hprot::prot_size_t size = static_cast<hprot::prot_size_t>(__strArray.size());
 			if (size > __remoteMaxSeqSize) {
 				return false;
@@ -375,13 +604,35 @@ namespace dprop {
 				ParseValue<E>(val, s);
 				valueArray.push_back(val);
 			}
-			return putRemoteArrayH<E>(__setCmd, valueArray, __remoteMaxSeqSize);
+			return putRemoteArrayH<E>(__setCmd, valueArray, __remoteMaxSeqSize, __packing);
 		}
 
 		////////////////////////////////////////////////////////////////////
 		/// Property getting/setting.
 		/// Sub-classes may override to change the default behavior
 
+		/** Has the slave reset since it last had our value? */
+		bool isStale() const {
+			return pProto_ && linkEpoch_ != pProto_->linkEpoch();
+		}
+
+		/** Send the cached value again if the slave reset since it was last set.
+		Properties without a set command simply read the value again on the next get. */
+		virtual int refreshIfStale() {
+			if (!isStale()) {
+				return DEVICE_OK;
+			}
+			unsigned epoch = pProto_->linkEpoch();
+			if (cmds_.cmdSet()) {
+				int ret = setRemoteValueH(BaseClass::cachedValue_);
+				if (ret != DEVICE_OK) {
+					return ret;
+				}
+			}
+			linkEpoch_ = epoch;
+			return DEVICE_OK;
+		}
+
 		/** Get the value from the remote. Derived classes may override. */
 		virtual int getRemoteValueH(T& __val) {
 			if (cmds_.hasChan()) {
@@ -414,7 +665,10 @@ namespace dprop {
 		/// Sequence setting and triggering
 		/// Sub-classes may override to change the default behavior
 
-		/** Get the maximum size of the remote sequence. Derived classes may override. */
+		/** Get the maximum size of the remote sequence. Derived classes may override.
+		A generator slave reports how many instructions it holds. A sequence of that
+		many values never compresses to more instructions, so it is the size reported
+		here. Longer sequences that do compress can be sent with setRemoteGeneratorH(). */
 		virtual int getRemoteSequenceSizeH(hprot::prot_size_t& __size) const {
 			__size = getRemoteArrayMaxSizeH<T>(cmds_.cmdSetSeq());
 			return DEVICE_OK;
@@ -422,18 +676,51 @@ namespace dprop {
 
 		/** Set a remote sequence. Derived classes may override. */
 		virtual int setRemoteSequenceH(const std::vector<std::string> __sequence) {
+			if (cmds_.seqGenerator()) {
+				std::vector<T> values;
+				for (auto s : __sequence) {
+					T val;
+					ParseValue<T>(val, s);
+					values.push_back(val);
+				}
+				return setRemoteGeneratorH(SequenceGenerator<T>::fromValues(values));
+			}
 			hprot::prot_size_t maxSize = getRemoteArrayMaxSizeH<T>(cmds_.cmdSetSeq());
 			if (__sequence.size() > maxSize) {
 				return DEVICE_SEQUENCE_TOO_LARGE;
 			}
 			// Use a helper function to send the sequence string array
 			// to the device
-			if (!putRemoteStringArrayH<T>(cmds_.cmdSetSeq(), __sequence, maxSize)) {
+			if (!putRemoteStringArrayH<T>(cmds_.cmdSetSeq(), __sequence, maxSize, seqPacking_)) {
 				return ERR_COMMUNICATION;
 			}
 			return DEVICE_OK;
 		}
 
+		/** Upload a sequence generator program. Needs a CommandSet withSeqGenerator(). 
+		The dispatch itself checks the program against the slave's capacity, so a
+		program with too many instructions fails with ERR_COMMUNICATION.
+		Derived classes may override. */
+		virtual int setRemoteGeneratorH(const SequenceGenerator<T>& __gen) {
+			assert(cmds_.seqGenerator());
+			typename ProtocolClass::StreamGuard monitor(pProto_);
+			const std::vector<hprot::ProtSeqOp<T>>& ops = __gen.ops();
+			if (ops.size() > std::numeric_limits<hprot::prot_size_t>::max()) {
+				return DEVICE_SEQUENCE_TOO_LARGE;
+			}
+			hprot::prot_size_t size = static_cast<hprot::prot_size_t>(ops.size());
+			if (cmds_.hasChan()) {
+				if (pProto_->dispatchChannelSetSequence(cmds_.cmdSetSeq(), cmds_.cmdChan(), ops.data(), size)) {
+					return DEVICE_OK;
+				}
+			} else {
+				if (pProto_->dispatchSetSequence(cmds_.cmdSetSeq(), ops.data(), size)) {
+					return DEVICE_OK;
+				}
+			}
+			return ERR_COMMUNICATION;
+		}
+
 		/** Start the remote sequence. Derived classes may override. */
 		virtual int startRemoteSequenceH() {
 			if (cmds_.hasChan()) {
@@ -462,11 +749,33 @@ namespace dprop {
 			return ERR_COMMUNICATION;
 		}
 
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+		/** Name of a property action for the trace. */
+		static const char* traceActionName(MM::ActionType __eAct) {
+			switch (__eAct) {
+			case MM::BeforeGet: return "BeforeGet";
+			case MM::AfterSet: return "AfterSet";
+			case MM::IsSequenceable: return "IsSequenceable";
+			case MM::AfterLoadSequence: return "AfterLoadSequence";
+			case MM::StartSequence: return "StartSequence";
+			case MM::StopSequence: return "StopSequence";
+			default: return "NoAction";
+			}
+		}
+#endif
+
 		/* Called by the properties update method.
 			 This is the main Property update routine. */
 		virtual int OnExecute(MM::PropertyBase* pProp, MM::ActionType eAct) override {
+#ifdef TRACE_DEVICE_HEX_PROTOCOL
+			// opened before the guard so the span includes any wait for the stream lock
+			hprot::TraceSpan span(pProto_->traceRecorder(), "property", BaseClass::name_, traceActionName(eAct));
+#endif
 			typename ProtocolClass::StreamGuard monitor(pProto_);
 			int result;
+			if (eAct != MM::AfterSet && (result = refreshIfStale()) != DEVICE_OK) {
+				return result;
+			}
 			if (eAct == MM::BeforeGet) {
 				if (cmds_.cmdGet()) {
 					// read the value from the remote device
@@ -487,6 +796,7 @@ namespace dprop {
 					return result;
 				}
 				BaseClass::cachedValue_ = temp;
+				linkEpoch_ = pProto_->linkEpoch();
 				return notifyChangeH(BaseClass::cachedValue_);
 			} else if (cmds_.cmdSetSeq() && eAct == MM::IsSequenceable) {
 				hprot::prot_size_t maxSize;
@@ -593,6 +903,12 @@ namespace dprop {
 			return setRemoteSequenceH(__sequence);
 		}
 
+		/** Set a remote sequence from a generator program without expanding it.
+		Needs a CommandSet withSeqGenerator(). */
+		int setRemoteGenerator(const SequenceGenerator<T>& __gen) {
+			return setRemoteGeneratorH(__gen);
+		}
+
 		/** Start the remote sequence. */
 		int startRemoteSequence() {
 			return startRemoteSequenceH();
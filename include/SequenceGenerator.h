@@ -0,0 +1,128 @@
+/**
+\ingroup	RemoteProp
+\file		SequenceGenerator.h
+\brief		Builds the sequence generator programs of remote sequences
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+
+Only needs HexProtocol.h, so the programs can be built and checked without 
+the Micro-Manager device headers that RemoteProp.h pulls in.
+*/
+
+#pragma once
+
+#include "HexProtocol.h"
+#include <vector>
+
+namespace dprop {
+
+	/** Builder for the sequence generator programs of slaves that keep a 
+	sequence as an hprot::ProtSequence.
+
+	\ingroup RemoteProp
+
+	Ramps are joined with then() and played again with repeat(). The slave
+	computes the values as it steps through the sequence, so the upload does 
+	not grow with the length of the sequence.
+	\code{.cpp}
+	// a triangle wave played 100 times
+	SequenceGenerator<float> tri = SequenceGenerator<float>::ramp(0, 0.5f, 20)
+		.then(SequenceGenerator<float>::ramp(10, -0.5f, 20)).repeat(100);
+	zProp.setRemoteGenerator(tri);
+	\endcode
+	@tparam T	value type of the sequence
+	*/
+	template <typename T>
+	class SequenceGenerator {
+	public:
+		typedef hprot::ProtSeqOp<T> OpType;
+
+		/** __count values, __start + k * __step */
+		static SequenceGenerator ramp(T __start, T __step, hprot::prot_ulong_t __count) {
+			SequenceGenerator gen;
+			if (__count > 0) {
+				gen.ops_.push_back(OpType::ramp(__start, __step, __count));
+			}
+			return gen;
+		}
+
+		/** A program that generates __values. Arithmetic runs become ramps, and
+		values that repeat with a whole period are sent once with a repeat. */
+		static SequenceGenerator fromValues(const std::vector<T>& __values) {
+			size_t size = __values.size();
+			// find the shortest whole period
+			size_t period = size;
+			for (size_t p = 1; p <= size / 2; p++) {
+				if (size % p != 0) {
+					continue;
+				}
+				size_t i = p;
+				while (i < size && __values[i] == __values[i - p]) {
+					i++;
+				}
+				if (i == size) {
+					period = p;
+					break;
+				}
+			}
+			SequenceGenerator gen;
+			for (size_t i = 0; i < period; ) {
+				T step;
+				size_t left = period - i;
+				hprot::prot_size_t len = static_cast<hprot::prot_size_t>(left < 0xFFFF ? left : 0xFFFF);
+				len = hprot::ProtArrayRun<T>::length(&__values[i], len, step);
+				gen.ops_.push_back(OpType::ramp(__values[i], len > 1 ? step : T(), len));
+				i += len;
+			}
+			return period < size ? gen.repeat(static_cast<hprot::prot_ulong_t>(size / period)) : gen;
+		}
+
+		/** Concatenate __next after this sequence */
+		SequenceGenerator& then(const SequenceGenerator& __next) {
+			ops_.insert(ops_.end(), __next.ops_.begin(), __next.ops_.end());
+			return *this;
+		}
+
+		/** This sequence played __times in all */
+		SequenceGenerator repeat(hprot::prot_ulong_t __times) const {
+			if (__times == 0) {
+				return SequenceGenerator();
+			}
+			SequenceGenerator gen(*this);
+			if (__times > 1 && !ops_.empty()) {
+				gen.ops_.push_back(OpType::repeat(static_cast<hprot::prot_size_t>(ops_.size()), __times));
+			}
+			return gen;
+		}
+
+		/** The program, one instruction per element */
+		const std::vector<OpType>& ops() const {
+			return ops_;
+		}
+
+		/** Number of values the program generates */
+		hprot::prot_ullong_t length() const {
+			// values generated by each instruction, including the blocks it repeats
+			std::vector<hprot::prot_ullong_t> spans;
+			hprot::prot_ullong_t total = 0;
+			for (const OpType& op : ops_) {
+				hprot::prot_ullong_t span = op.count;
+				if (op.kind == hprot::SUBCMD_SEQ_REPEAT) {
+					hprot::prot_ullong_t block = 0;
+					for (size_t i = spans.size() - op.block; i < spans.size(); i++) {
+						block += spans[i];
+					}
+					span = (op.count - 1) * block;
+				}
+				spans.push_back(span);
+				total += span;
+			}
+			return total;
+		}
+
+	protected:
+		std::vector<OpType> ops_;
+	};
+
+}; // namespace dprop
@@ -0,0 +1,178 @@
+/**
+\ingroup	DeviceHexProtocol
+\file		StreamCache.h
+\brief		Persistent last-known-good port and baud rate for each device
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+/**
+\ingroup DeviceHexProtocol
+
+\page AboutStreamCache About the Stream Cache
+
+About the Stream Cache
+==========================
+
+A hub almost always sits on the same serial port at the same baud rate.
+StreamCache remembers the last port, baud rate and firmware fingerprint
+that worked for each device name, so DeviceHexProtocol::detectStream()
+can try that port first and only scan every port when it fails.
+
+The cache is a small tab-separated text file, one device per line
+
+	device-name	port	baud	fingerprint
+
+stored as \c HexProtocolStreams.txt in \c %LOCALAPPDATA% on Windows, or as
+\c .hexprotocol-streams in \c $HOME elsewhere. The file may be deleted at
+any time to force a full scan.
+*/
+
+#pragma once
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace hprot {
+
+	/** One cached device. \ingroup DeviceHexProtocol */
+	struct StreamCacheEntry {
+		std::string device;			///< device name, the cache key
+		std::string stream;			///< port name
+		long baudRate;				///< baud rate
+		std::string fingerprint;	///< firmware fingerprint, may be empty
+
+		StreamCacheEntry() : baudRate(0) { }
+	};
+
+	/**
+	Reads and writes the last-known-good stream for each device.
+
+	\ingroup DeviceHexProtocol
+
+	Failures to read or write the cache file are never fatal. They simply
+	mean a full port scan.
+	*/
+	class StreamCache {
+	public:
+		/** Use the default cache file. */
+		StreamCache() : fileName_(defaultFileName()) { }
+
+		/** Use a specific cache file. */
+		StreamCache(const std::string& __fileName) : fileName_(__fileName) { }
+
+		/** Look up __device. @return false if the device is not in the cache */
+		bool load(const std::string& __device, StreamCacheEntry& __entry) const {
+			std::vector<StreamCacheEntry> entries = readAll();
+			for (const StreamCacheEntry& entry : entries) {
+				if (entry.device == clean(__device)) {
+					__entry = entry;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/** Add or replace the entry for __entry.device. @return true if the file was written */
+		bool save(const StreamCacheEntry& __entry) const {
+			std::vector<StreamCacheEntry> entries = readAll();
+			bool found = false;
+			for (StreamCacheEntry& entry : entries) {
+				if (entry.device == clean(__entry.device)) {
+					entry = __entry;
+					found = true;
+				}
+			}
+			if (!found) {
+				entries.push_back(__entry);
+			}
+			return writeAll(entries);
+		}
+
+		/** Forget __device. @return true if the file was written */
+		bool erase(const std::string& __device) const {
+			std::vector<StreamCacheEntry> entries = readAll();
+			std::vector<StreamCacheEntry> keep;
+			for (const StreamCacheEntry& entry : entries) {
+				if (entry.device != clean(__device)) {
+					keep.push_back(entry);
+				}
+			}
+			return keep.size() == entries.size() || writeAll(keep);
+		}
+
+		/** Does a firmware __fingerprint match the one saved in __entry? An empty 
+		saved fingerprint matches anything. Fields are saved with clean(), so
+		__fingerprint is compared the same way. */
+		static bool matches(const StreamCacheEntry& __entry, const std::string& __fingerprint) {
+			return __entry.fingerprint.empty() || __entry.fingerprint == clean(__fingerprint);
+		}
+
+		/** The cache file used by this object. */
+		const std::string& fileName() const {
+			return fileName_;
+		}
+
+		/** The default cache file in the user's local application data or home directory. */
+		static std::string defaultFileName() {
+#ifdef _WIN32
+			const char* dir = getenv("LOCALAPPDATA");
+			return dir ? std::string(dir) + "\\HexProtocolStreams.txt" : std::string("HexProtocolStreams.txt");
+#else
+			const char* dir = getenv("HOME");
+			return dir ? std::string(dir) + "/.hexprotocol-streams" : std::string(".hexprotocol-streams");
+#endif
+		}
+
+	protected:
+		std::string fileName_;
+
+		std::vector<StreamCacheEntry> readAll() const {
+			std::vector<StreamCacheEntry> entries;
+			std::ifstream in(fileName_.c_str());
+			std::string line;
+			while (std::getline(in, line)) {
+				std::vector<std::string> fields;
+				std::istringstream ss(line);
+				std::string field;
+				while (std::getline(ss, field, '\t')) {
+					fields.push_back(field);
+				}
+				if (fields.size() < 3) {
+					continue;
+				}
+				StreamCacheEntry entry;
+				entry.device = fields[0];
+				entry.stream = fields[1];
+				entry.baudRate = atol(fields[2].c_str());
+				entry.fingerprint = fields.size() > 3 ? fields[3] : std::string();
+				entries.push_back(entry);
+			}
+			return entries;
+		}
+
+		bool writeAll(const std::vector<StreamCacheEntry>& __entries) const {
+			std::ofstream out(fileName_.c_str(), std::ios::out | std::ios::trunc);
+			for (const StreamCacheEntry& entry : __entries) {
+				out << clean(entry.device) << '\t' << clean(entry.stream) << '\t'
+					<< entry.baudRate << '\t' << clean(entry.fingerprint) << '\n';
+			}
+			return out.good();
+		}
+
+		/** Tabs and newlines would break the file format. */
+		static std::string clean(std::string __str) {
+			for (char& c : __str) {
+				if (c == '\t' || c == '\n' || c == '\r') {
+					c = ' ';
+				}
+			}
+			return __str;
+		}
+	};
+
+}; // namespace hprot
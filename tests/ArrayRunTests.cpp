@@ -0,0 +1,83 @@
+/**
+\file		ArrayRunTests.cpp
+\brief		Runs of array elements found by ProtArrayRun::length()
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+#include "HexProtocol.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace hprot;
+
+void checkIntRuns() {
+	int step = 0;
+	int ramp[] = { 1, 3, 5, 7, 10 };
+	CHECK(ProtArrayRun<int>::length(ramp, 5, step) == 4 && step == 2);
+	CHECK(ProtArrayRun<int>::length(ramp + 3, 2, step) == 2 && step == 3);
+	CHECK(ProtArrayRun<int>::length(ramp, 1, step) == 1 && step == 0);
+	CHECK(ProtArrayRun<int>::length(ramp, 0, step) == 0);
+
+	int flat[] = { 4, 4, 4, 4 };
+	CHECK(ProtArrayRun<int>::length(flat, 4, step) == 4 && step == 0);
+
+	// integer runs wrap like unsigned values
+	std::uint8_t wrap[] = { 250, 255, 4, 9 };
+	std::uint8_t ustep = 0;
+	CHECK(ProtArrayRun<std::uint8_t>::length(wrap, 4, ustep) == 4 && ustep == 5);
+	int big[] = { std::numeric_limits<int>::max() - 1, std::numeric_limits<int>::max(), std::numeric_limits<int>::min() };
+	CHECK(ProtArrayRun<int>::length(big, 3, step) == 3 && step == 1);
+	CHECK(ProtArrayRun<int>::at(big[0], step, 2) == big[2]);
+}
+
+void checkFloatRuns() {
+	float step = 0;
+	float ramp[] = { 0.0f, 0.1f, 0.2f, 0.3f, 0.4f, 1.0f };
+	CHECK(ProtArrayRun<float>::length(ramp, 6, step) == 5);
+	CHECK(step > 0.0999f && step < 0.1001f);
+	float flat[] = { 2.5f, 2.5f, 2.5f };
+	CHECK(ProtArrayRun<float>::length(flat, 3, step) == 3 && step == 0.0f);
+	float bent[] = { 0.0f, 1.0f, 2.0f, 4.0f };
+	CHECK(ProtArrayRun<float>::length(bent, 4, step) == 3 && step == 1.0f);
+	float one[] = { 7.0f };
+	CHECK(ProtArrayRun<float>::length(one, 1, step) == 1);
+
+	// a NaN is never part of a run
+	float nan[] = { 0.0f, 1.0f, std::numeric_limits<float>::quiet_NaN(), 3.0f };
+	CHECK(ProtArrayRun<float>::length(nan, 4, step) == 2);
+
+	double dstep = 0;
+	double dramp[] = { -1.0, -0.5, 0.0, 0.5, 1.0 };
+	CHECK(ProtArrayRun<double>::length(dramp, 5, dstep) == 5 && dstep == 0.5);
+}
+
+/** Long ramps are found whole, and a bend ends them at the right element */
+void checkLongFloatRuns() {
+	const prot_size_t n = 30000;
+	std::vector<float> ramp(n);
+	for (prot_size_t k = 0; k < n; k++) {
+		ramp[k] = 0.1f * static_cast<float>(k);
+	}
+	float step = 0;
+	CHECK(ProtArrayRun<float>::length(ramp.data(), n, step) == n);
+	CHECK(std::fabs(step - 0.1f) < 1e-5f);
+
+	const prot_size_t bend = 12345;
+	for (prot_size_t k = bend; k < n; k++) {
+		ramp[k] = ramp[bend - 1] + 0.3f * static_cast<float>(k - bend + 1);
+	}
+	CHECK(ProtArrayRun<float>::length(ramp.data(), n, step) == bend);
+	CHECK(ProtArrayRun<float>::length(ramp.data() + bend - 1, n - bend + 1, step) == n - bend + 1);
+}
+
+int main() {
+	checkIntRuns();
+	checkFloatRuns();
+	checkLongFloatRuns();
+	return hprottest::testResult("ArrayRunTests");
+}
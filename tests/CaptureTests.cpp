@@ -0,0 +1,136 @@
+/**
+\file		CaptureTests.cpp
+\brief		Rendering, dumping and decoding of transaction captures
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+#include "ProtocolCapture.h"
+#include "TestCheck.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace hprot;
+
+/** One get transaction: command 'M', a value sent and the echoed reply */
+template <size_t N>
+void recordGet(TransactionCapture<N>& __cap) {
+	__cap.begin();
+	__cap.record(CAPTURE_CMD, "M", 1);
+	__cap.record(CAPTURE_SEND, "1f", 2, ASCII_EOT);
+	__cap.record(CAPTURE_RECV, "4d", 2, ASCII_EOT);
+	__cap.end();
+}
+
+bool sameRecord(const CaptureRecord& __a, const CaptureRecord& __b) {
+	return __a.time == __b.time && __a.dir == __b.dir && __a.len == __b.len
+		&& memcmp(__a.bytes, __b.bytes, __a.len) == 0;
+}
+
+void checkRender() {
+	TransactionCapture<64> cap;
+	recordGet(cap);
+	CHECK(renderTransaction(cap.lastTransaction()) == "M=0x4d: [1f\\x4] {4d\\x4}");
+
+	// two commands in one transaction are split by an @
+	cap.begin();
+	cap.record(CAPTURE_CMD, "A", 1);
+	cap.record(CAPTURE_RECV, "41", 2, ASCII_EOT);
+	cap.record(CAPTURE_CMD, "B", 1);
+	cap.record(CAPTURE_RECV_EMPTY, nullptr, 0);
+	cap.end();
+	CHECK(renderTransaction(cap.lastTransaction()) == "A=0x41: {41\\x4} @ B=0x42: {empty}");
+}
+
+void checkContinued() {
+	// a payload longer than a record spills into continuation records
+	std::string longText(3 * PROT_CAPTURE_BYTES + 5, 'x');
+	TransactionCapture<64> cap;
+	cap.begin();
+	cap.record(CAPTURE_CMD, "S", 1);
+	cap.record(CAPTURE_SEND, longText.c_str(), longText.size(), ASCII_EOT);
+	cap.end();
+	std::vector<CaptureRecord> recs = cap.lastTransaction();
+	CHECK(recs.size() == 1 + 1 + 4 + 1 + 1);
+	CHECK(renderTransaction(recs) == "S=0x53: [" + longText + "\\x4]");
+}
+
+void checkLastTransaction() {
+	TransactionCapture<8> cap;
+	CHECK(cap.lastTransaction().empty());
+	recordGet(cap);
+	recordGet(cap);
+	// the ring has wrapped, but the last transaction is still whole
+	CHECK(cap.size() == 8);
+	CHECK(cap.sequence() == 10);
+	CHECK(cap.lastTransaction().size() == 5);
+	// an open transaction is not returned
+	cap.begin();
+	cap.record(CAPTURE_CMD, "Z", 1);
+	CHECK(renderTransaction(cap.lastTransaction()) == "M=0x4d: [1f\\x4] {4d\\x4}");
+}
+
+void checkDumpAndRead() {
+	TransactionCapture<64> cap;
+	recordGet(cap);
+	recordGet(cap);
+	std::stringstream file(std::ios::in | std::ios::out | std::ios::binary);
+	CHECK(cap.dump(file));
+
+	std::vector<CaptureRecord> recs;
+	CHECK(readCapture(file, recs));
+	std::vector<CaptureRecord> orig = cap.records();
+	CHECK(recs.size() == orig.size());
+	for (size_t i = 0; i < recs.size() && i < orig.size(); i++) {
+		CHECK(sameRecord(recs[i], orig[i]));
+	}
+
+	std::ostringstream os;
+	file.clear();
+	file.seekg(0);
+	CHECK(decodeCapture(file, os));
+	std::string text = os.str();
+	CHECK(text.find("+0ms  M=0x4d: [1f\\x4] {4d\\x4}") == 0);
+	CHECK(text.find("M=0x4d", 1) != std::string::npos);
+}
+
+void checkBadFiles() {
+	std::vector<CaptureRecord> recs;
+	std::istringstream empty("");
+	CHECK(!readCapture(empty, recs));
+	std::istringstream wrongMagic(std::string("HPCAP99\0\0\0", 10));
+	CHECK(!readCapture(wrongMagic, recs));
+
+	// cut off in the middle of a record
+	TransactionCapture<64> cap;
+	recordGet(cap);
+	std::ostringstream os(std::ios::out | std::ios::binary);
+	cap.dump(os);
+	std::string full = os.str();
+	std::istringstream truncated(full.substr(0, full.size() - 2));
+	CHECK(!readCapture(truncated, recs));
+}
+
+void checkUInt() {
+	std::uint64_t vals[] = { 0, 1, 127, 128, 300, 0xFFFFFFFFull, 0xFFFFFFFFFFFFFFFFull };
+	for (std::uint64_t val : vals) {
+		std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+		TransactionCapture<2>::writeCaptureUInt(ss, val);
+		std::uint64_t back = 0;
+		CHECK(readCaptureUInt(ss, back) && back == val);
+	}
+}
+
+int main() {
+	checkRender();
+	checkContinued();
+	checkLastTransaction();
+	checkDumpAndRead();
+	checkBadFiles();
+	checkUInt();
+	return hprottest::testResult("CaptureTests");
+}
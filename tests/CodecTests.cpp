@@ -0,0 +1,172 @@
+/**
+\file		CodecTests.cpp
+\brief		Round trips through the value codecs, and zigzag encoding
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+#include "HexProtocol.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace hprot;
+
+/** Encode __val with CODEC and decode it again. */
+template <class CODEC, typename T>
+bool intRoundTrip(T __val) {
+	char buf[CODEC::LLONG_BUFF_SIZE + 1];
+	memset(buf, 0, sizeof(buf));
+	size_t len = CODEC::encodeInt(__val, buf);
+	if (len == 0 || len >= sizeof(buf)) {
+		return false;
+	}
+	// the protocol replaces the terminator with a null
+	buf[len] = '\0';
+	T back = T();
+	return CODEC::decodeInt(buf, len, back) && back == __val;
+}
+
+/** Encode __val with CODEC and decode it again. NaN only has to stay NaN. */
+template <class CODEC>
+bool floatRoundTrip(prot_float_t __val) {
+	char buf[CODEC::FLOAT_BUFF_SIZE + 1];
+	memset(buf, 0, sizeof(buf));
+	size_t len = CODEC::encodeFloat(__val, buf);
+	if (len == 0 || len >= sizeof(buf)) {
+		return false;
+	}
+	buf[len] = '\0';
+	prot_float_t back = 0;
+	if (!CODEC::decodeFloat(buf, len, back)) {
+		return false;
+	}
+	if (std::isnan(__val)) {
+		return std::isnan(back);
+	}
+	return back == __val && std::signbit(back) == std::signbit(__val);
+}
+
+/** Limits and a few values in between of each integer type */
+template <class CODEC>
+void checkIntegers() {
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<std::int8_t>::min()));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<std::int8_t>::max()));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<std::uint8_t>::max()));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<std::int16_t>::min()));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<std::uint16_t>::max()));
+
+	CHECK(intRoundTrip<CODEC>(prot_long_t(0)));
+	CHECK(intRoundTrip<CODEC>(prot_long_t(1)));
+	CHECK(intRoundTrip<CODEC>(prot_long_t(-1)));
+	CHECK(intRoundTrip<CODEC>(prot_long_t(-1000000)));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<prot_long_t>::min()));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<prot_long_t>::max()));
+	CHECK(intRoundTrip<CODEC>(prot_ulong_t(0)));
+	CHECK(intRoundTrip<CODEC>(prot_ulong_t(0xDEADBEEF)));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<prot_ulong_t>::max()));
+
+	CHECK(intRoundTrip<CODEC>(prot_llong_t(0)));
+	CHECK(intRoundTrip<CODEC>(prot_llong_t(-1)));
+	CHECK(intRoundTrip<CODEC>(prot_llong_t(-0x123456789ALL)));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<prot_llong_t>::min()));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<prot_llong_t>::max()));
+	CHECK(intRoundTrip<CODEC>(prot_ullong_t(0xDEADBEEFCAFEBABEULL)));
+	CHECK(intRoundTrip<CODEC>(std::numeric_limits<prot_ullong_t>::max()));
+
+	// every byte value of a channel
+	for (int c = -128; c < 128; c++) {
+		CHECK(intRoundTrip<CODEC>(static_cast<prot_chan_t>(c)));
+	}
+}
+
+template <class CODEC>
+void checkFloats() {
+	CHECK(floatRoundTrip<CODEC>(0.0f));
+	CHECK(floatRoundTrip<CODEC>(-0.0f));
+	CHECK(floatRoundTrip<CODEC>(1.5f));
+	CHECK(floatRoundTrip<CODEC>(-3.14159f));
+	CHECK(floatRoundTrip<CODEC>(std::numeric_limits<prot_float_t>::max()));
+	CHECK(floatRoundTrip<CODEC>(std::numeric_limits<prot_float_t>::min()));
+	CHECK(floatRoundTrip<CODEC>(std::numeric_limits<prot_float_t>::denorm_min()));
+	CHECK(floatRoundTrip<CODEC>(std::numeric_limits<prot_float_t>::infinity()));
+	CHECK(floatRoundTrip<CODEC>(-std::numeric_limits<prot_float_t>::infinity()));
+	CHECK(floatRoundTrip<CODEC>(std::numeric_limits<prot_float_t>::quiet_NaN()));
+}
+
+/** The binary codecs never put a control character on the wire */
+template <class CODEC>
+void checkNoControlBytes() {
+	char buf[CODEC::LLONG_BUFF_SIZE];
+	prot_llong_t vals[] = { 0, 1, -1, std::numeric_limits<prot_llong_t>::min(), 0x7F7F7F7F7FLL };
+	for (prot_llong_t val : vals) {
+		size_t len = CODEC::encodeInt(val, buf);
+		for (size_t i = 0; i < len; i++) {
+			CHECK((static_cast<prot_byte_t>(buf[i]) & 0x80) != 0);
+		}
+	}
+}
+
+void checkHexText() {
+	char buf[HexCodec::LLONG_BUFF_SIZE];
+	HexCodec::encodeInt(prot_long_t(-26), buf);
+	CHECK(strcmp(buf, "-1a") == 0);
+	HexCodec::encodeInt(prot_ulong_t(0xDEADBEEF), buf);
+	CHECK(strcmp(buf, "deadbeef") == 0);
+	HexCodec::encodeInt(std::numeric_limits<prot_long_t>::min(), buf);
+	CHECK(strcmp(buf, "-80000000") == 0);
+	HexCodec::encodeInt(std::numeric_limits<prot_llong_t>::min(), buf);
+	CHECK(strcmp(buf, "-8000000000000000") == 0);
+}
+
+void checkVarintLength() {
+	char buf[VarintCodec::LLONG_BUFF_SIZE];
+	// small magnitudes of either sign take a single byte
+	CHECK(VarintCodec::encodeInt(prot_long_t(0), buf) == 1);
+	CHECK(VarintCodec::encodeInt(prot_long_t(-64), buf) == 1);
+	CHECK(VarintCodec::encodeInt(prot_long_t(63), buf) == 1);
+	CHECK(VarintCodec::encodeInt(prot_long_t(64), buf) == 2);
+	CHECK(VarintCodec::encodeInt(std::numeric_limits<prot_long_t>::min(), buf) == VarintCodec::INT_BYTES);
+	CHECK(VarintCodec::encodeInt(std::numeric_limits<prot_ullong_t>::max(), buf) == VarintCodec::LLONG_BYTES);
+	// too long for the type
+	prot_ulong_t narrow = 0;
+	CHECK(!VarintCodec::decodeInt(buf, VarintCodec::LLONG_BYTES, narrow));
+}
+
+void checkZigzag() {
+	CHECK(VarintCodec::zigzag(prot_long_t(0)) == 0u);
+	CHECK(VarintCodec::zigzag(prot_long_t(-1)) == 1u);
+	CHECK(VarintCodec::zigzag(prot_long_t(1)) == 2u);
+	CHECK(VarintCodec::zigzag(prot_long_t(-2)) == 3u);
+	CHECK(VarintCodec::zigzag(std::numeric_limits<prot_long_t>::max()) == 0xFFFFFFFEu);
+	CHECK(VarintCodec::zigzag(std::numeric_limits<prot_long_t>::min()) == 0xFFFFFFFFu);
+	CHECK(VarintCodec::zigzag(std::numeric_limits<prot_llong_t>::min()) == 0xFFFFFFFFFFFFFFFFull);
+
+	CHECK(VarintCodec::unzigzag(prot_ulong_t(0)) == 0);
+	CHECK(VarintCodec::unzigzag(prot_ulong_t(1)) == -1);
+	CHECK(VarintCodec::unzigzag(prot_ulong_t(2)) == 1);
+	CHECK(VarintCodec::unzigzag(prot_ulong_t(0xFFFFFFFF)) == std::numeric_limits<prot_long_t>::min());
+	CHECK(VarintCodec::unzigzag(prot_ullong_t(0xFFFFFFFFFFFFFFFFull)) == std::numeric_limits<prot_llong_t>::min());
+
+	for (prot_long_t v = -1000; v <= 1000; v++) {
+		CHECK(VarintCodec::unzigzag(VarintCodec::zigzag(v)) == v);
+	}
+}
+
+int main() {
+	checkIntegers<HexCodec>();
+	checkIntegers<BinaryCodec>();
+	checkIntegers<VarintCodec>();
+	checkFloats<HexCodec>();
+	checkFloats<BinaryCodec>();
+	checkFloats<VarintCodec>();
+	checkNoControlBytes<BinaryCodec>();
+	checkNoControlBytes<VarintCodec>();
+	checkHexText();
+	checkVarintLength();
+	checkZigzag();
+	return hprottest::testResult("CodecTests");
+}
@@ -0,0 +1,103 @@
+/**
+\file		HalfFloatTests.cpp
+\brief		prot_ftohalf() and prot_halftof() on normals, subnormals, Inf, NaN and ties
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+#include "HexProtocol.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace hprot;
+
+void checkNormals() {
+	CHECK(prot_ftohalf(0.0f) == 0x0000);
+	CHECK(prot_ftohalf(-0.0f) == 0x8000);
+	CHECK(prot_ftohalf(1.0f) == 0x3C00);
+	CHECK(prot_ftohalf(-2.0f) == 0xC000);
+	CHECK(prot_ftohalf(0.5f) == 0x3800);
+	CHECK(prot_ftohalf(65504.0f) == 0x7BFF);		// largest half
+	CHECK(prot_ftohalf(std::ldexp(1.0f, -14)) == 0x0400);	// smallest normal half
+
+	CHECK(prot_halftof(0x3C00) == 1.0f);
+	CHECK(prot_halftof(0xC000) == -2.0f);
+	CHECK(prot_halftof(0x7BFF) == 65504.0f);
+	CHECK(prot_halftof(0x8000) == 0.0f && std::signbit(prot_halftof(0x8000)));
+}
+
+void checkSubnormals() {
+	const float tiny = std::ldexp(1.0f, -24);	// smallest subnormal half
+	CHECK(prot_ftohalf(tiny) == 0x0001);
+	CHECK(prot_ftohalf(-tiny) == 0x8001);
+	CHECK(prot_ftohalf(1023 * tiny) == 0x03FF);	// largest subnormal half
+	CHECK(prot_halftof(0x0001) == tiny);
+	CHECK(prot_halftof(0x03FF) == 1023 * tiny);
+	CHECK(prot_halftof(0x0200) == 512 * tiny);
+
+	// too small for a half, but keeps its sign
+	CHECK(prot_ftohalf(std::ldexp(1.0f, -26)) == 0x0000);
+	CHECK(prot_ftohalf(-std::ldexp(1.0f, -26)) == 0x8000);
+	// float subnormals are far below the half range
+	CHECK(prot_ftohalf(std::numeric_limits<float>::denorm_min()) == 0x0000);
+	CHECK(prot_ftohalf(-std::numeric_limits<float>::denorm_min()) == 0x8000);
+}
+
+void checkInfNaN() {
+	const float inf = std::numeric_limits<float>::infinity();
+	CHECK(prot_ftohalf(inf) == 0x7C00);
+	CHECK(prot_ftohalf(-inf) == 0xFC00);
+	// overflow rounds to infinity
+	CHECK(prot_ftohalf(65520.0f) == 0x7C00);
+	CHECK(prot_ftohalf(1e10f) == 0x7C00);
+	CHECK(prot_ftohalf(-1e10f) == 0xFC00);
+	CHECK(prot_halftof(0x7C00) == inf);
+	CHECK(prot_halftof(0xFC00) == -inf);
+
+	prot_half_t nan = prot_ftohalf(std::numeric_limits<float>::quiet_NaN());
+	CHECK((nan & 0x7C00) == 0x7C00 && (nan & 0x03FF) != 0);
+	CHECK(std::isnan(prot_halftof(nan)));
+	CHECK(std::isnan(prot_halftof(0x7E00)));
+}
+
+void checkTies() {
+	// halfway between two halves rounds to the even one
+	const float ulp1 = std::ldexp(1.0f, -10);	// half spacing above 1
+	CHECK(prot_ftohalf(1.0f + ulp1 / 2) == 0x3C00);
+	CHECK(prot_ftohalf(1.0f + 3 * ulp1 / 2) == 0x3C02);
+	// just past halfway rounds up
+	CHECK(prot_ftohalf(1.0f + ulp1 / 2 + std::ldexp(1.0f, -20)) == 0x3C01);
+	// a carry out of the mantissa bumps the exponent
+	CHECK(prot_ftohalf(2.0f - ulp1 / 4) == 0x4000);
+
+	// the same among subnormals
+	const float tiny = std::ldexp(1.0f, -24);
+	CHECK(prot_ftohalf(tiny / 2) == 0x0000);
+	CHECK(prot_ftohalf(3 * tiny / 2) == 0x0002);
+	CHECK(prot_ftohalf(5 * tiny / 2) == 0x0002);
+	// the largest subnormal rounds up into the smallest normal
+	CHECK(prot_ftohalf(1023.5f * tiny) == 0x0400);
+}
+
+/** Every finite half survives the trip through a float */
+void checkAllHalves() {
+	for (prot_ulong_t h = 0; h <= 0xFFFF; h++) {
+		prot_half_t half = static_cast<prot_half_t>(h);
+		if ((half & 0x7C00) == 0x7C00) {
+			continue;
+		}
+		CHECK(prot_ftohalf(prot_halftof(half)) == half);
+	}
+}
+
+int main() {
+	checkNormals();
+	checkSubnormals();
+	checkInfNaN();
+	checkTies();
+	checkAllHalves();
+	return hprottest::testResult("HalfFloatTests");
+}
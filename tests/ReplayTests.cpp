@@ -0,0 +1,141 @@
+/**
+\file		ReplayTests.cpp
+\brief		Replay of captured sessions against an emulated slave
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+#include "ProtocolReplay.h"
+#include "TestCheck.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace hprot;
+
+/** One get transaction: a command, a value sent, and the reply or a timeout */
+template <size_t N>
+void recordGet(TransactionCapture<N>& __cap, const char* __cmd, const char* __reply) {
+	__cap.begin();
+	__cap.record(CAPTURE_CMD, __cmd, 1);
+	__cap.record(CAPTURE_SEND, "1", 1, ASCII_EOT);
+	if (__reply) {
+		__cap.record(CAPTURE_RECV, __reply, strlen(__reply), ASCII_EOT);
+	} else {
+		__cap.record(CAPTURE_RECV_EMPTY, nullptr, 0);
+	}
+	__cap.end();
+}
+
+/** Answers every read with the same reply */
+class ConstantSlave : public ReplayTransport {
+public:
+	ConstantSlave(const std::string& __reply) : reply_(__reply) { }
+	bool write(const char*, size_t) override {
+		return true;
+	}
+	bool readUntil(char, std::string& __answer) override {
+		__answer = reply_;
+		return true;
+	}
+protected:
+	std::string reply_;
+};
+
+void checkLoad() {
+	TransactionCapture<64> cap;
+	recordGet(cap, "A", "41");
+	recordGet(cap, "B", nullptr);
+	ReplaySession session;
+	session.loadRecords(cap.records());
+	CHECK(session.transactions().size() == 2);
+	CHECK(session.replies().size() == 2);
+	CHECK(session.tokens(CAPTURE_CMD).size() == 2);
+
+	// a getLastLog() string loads the same tokens, without timing
+	ReplaySession fromLog;
+	CHECK(fromLog.appendLog("A=0x41: [1\\x4] {41\\x4}"));
+	CHECK(fromLog.appendLog("B=0x42: [1\\x4] {empty}"));
+	CHECK(fromLog.transactions().size() == 2);
+	for (size_t t = 0; t < 2 && t < fromLog.transactions().size(); t++) {
+		const std::vector<ReplayToken>& a = session.transactions()[t].tokens;
+		const std::vector<ReplayToken>& b = fromLog.transactions()[t].tokens;
+		CHECK(a.size() == b.size());
+		for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+			CHECK(a[i].dir == b[i].dir && a[i].bytes == b[i].bytes);
+		}
+	}
+	CHECK(!fromLog.appendLog("A=0x41: [1"));
+}
+
+void checkReplay() {
+	TransactionCapture<64> cap;
+	recordGet(cap, "A", "41");
+	recordGet(cap, "B", "42");
+	ReplaySession session;
+	session.loadRecords(cap.records());
+	EmulatedSlave slave(session);
+	ReplayReport report = ReplayEngine().replay(session, slave);
+	CHECK(report.transactions == 2);
+	CHECK(report.commands == 2);
+	CHECK(report.roundTrips == 2);
+	CHECK(report.bytesSent == 2 * (1 + 2));
+	CHECK(report.bytesReceived == 2 * 3);
+	CHECK(report.failures == 0 && report.mismatches == 0 && report.timeouts == 0);
+	CHECK(report.latency.size() == 2 && report.latency['A'].count == 1);
+
+	// replaying again starts from the first reply
+	report = ReplayEngine().replay(session, slave);
+	CHECK(report.failures == 0 && report.mismatches == 0);
+}
+
+/** A recorded timeout times out again and does not use up the next reply */
+void checkRecordedTimeout() {
+	TransactionCapture<64> cap;
+	recordGet(cap, "A", nullptr);
+	recordGet(cap, "B", "42");
+	recordGet(cap, "C", "43");
+	ReplaySession session;
+	session.loadRecords(cap.records());
+	EmulatedSlave slave(session);
+	ReplayReport report = ReplayEngine().withStopOnFailure().replay(session, slave);
+	CHECK(report.transactions == 3);
+	CHECK(report.timeouts == 1);
+	CHECK(report.failures == 0);
+	CHECK(report.mismatches == 0);
+	CHECK(report.bytesReceived == 2 * 3);
+
+	// a slave that answers where the session timed out is a mismatch
+	ConstantSlave chatty("42\x4");
+	report = ReplayEngine().replay(session, chatty);
+	CHECK(report.timeouts == 0 && report.failures == 0);
+	CHECK(report.mismatches == 2);
+}
+
+void checkMissingReplies() {
+	TransactionCapture<64> cap;
+	recordGet(cap, "A", "41");
+	recordGet(cap, "B", "42");
+	ReplaySession session;
+	session.loadRecords(cap.records());
+	// a slave with fewer replies than the session fails the rest
+	TransactionCapture<64> shortCap;
+	recordGet(shortCap, "A", "41");
+	ReplaySession shortSession;
+	shortSession.loadRecords(shortCap.records());
+	EmulatedSlave slave(shortSession);
+	ReplayReport report = ReplayEngine().replay(session, slave);
+	CHECK(report.failures == 1 && report.mismatches == 0);
+	report = ReplayEngine().withStopOnFailure().replay(session, slave);
+	CHECK(report.failures == 1 && report.transactions == 2);
+}
+
+int main() {
+	checkLoad();
+	checkReplay();
+	checkRecordedTimeout();
+	checkMissingReplies();
+	return hprottest::testResult("ReplayTests");
+}
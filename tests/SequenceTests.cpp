@@ -0,0 +1,132 @@
+/**
+\file		SequenceTests.cpp
+\brief		Slave sequence programs and the host SequenceGenerator
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+*/
+
+#include "HexProtocol.h"
+#include "SequenceGenerator.h"
+#include "TestCheck.h"
+
+#include <vector>
+
+using namespace hprot;
+using dprop::SequenceGenerator;
+
+/** Play a program on the slave side. Empty if the slave refuses it. */
+template <typename T, prot_size_t N>
+std::vector<T> play(const SequenceGenerator<T>& __gen, ProtSequence<T, N>& __seq) {
+	__seq.restart();
+	for (const ProtSeqOp<T>& op : __gen.ops()) {
+		if (!__seq.append(op)) {
+			return std::vector<T>();
+		}
+	}
+	if (!__seq.finish(static_cast<prot_size_t>(__gen.ops().size()))) {
+		return std::vector<T>();
+	}
+	std::vector<T> vals;
+	T val;
+	while (__seq.next(val)) {
+		vals.push_back(val);
+	}
+	return vals;
+}
+
+void checkNestedRepeats() {
+	ProtSequence<int, 8> seq;
+	// (0 1 2 0 1 2 10) played twice
+	CHECK(seq.ramp(0, 1, 3));
+	CHECK(seq.repeat(1, 2));
+	CHECK(seq.ramp(10, 0, 1));
+	CHECK(seq.repeat(3, 2));
+	const int expect[] = { 0, 1, 2, 0, 1, 2, 10, 0, 1, 2, 0, 1, 2, 10 };
+	for (int round = 0; round < 2; round++) {
+		std::vector<int> vals;
+		int val;
+		while (seq.next(val)) {
+			vals.push_back(val);
+		}
+		CHECK(vals == std::vector<int>(expect, expect + 14));
+		CHECK(!seq.next(val));
+		seq.rewind();
+	}
+
+	// a repeat needs a whole block before it, and the program has a fixed size
+	ProtSequence<int, 2> small;
+	CHECK(!small.repeat(1, 2));
+	CHECK(small.ramp(0, 1, 2));
+	CHECK(!small.repeat(2, 2));
+	CHECK(!small.ramp(0, 1, 0));
+	CHECK(small.repeat(1, 3));
+	CHECK(!small.ramp(5, 0, 1));
+}
+
+void checkGeneratorLength() {
+	SequenceGenerator<int> gen = SequenceGenerator<int>::ramp(0, 1, 2)
+		.then(SequenceGenerator<int>::ramp(5, 0, 1)).repeat(3).repeat(2);
+	CHECK(gen.ops().size() == 4);
+	CHECK(gen.length() == 18);
+	ProtSequence<int, 8> seq;
+	std::vector<int> vals = play(gen, seq);
+	CHECK(vals.size() == 18);
+	CHECK(vals.size() >= 6 && vals[0] == 0 && vals[1] == 1 && vals[2] == 5 && vals[3] == 0);
+
+	CHECK(SequenceGenerator<int>::ramp(0, 1, 0).ops().empty());
+	CHECK(SequenceGenerator<int>::ramp(0, 1, 4).repeat(0).length() == 0);
+	CHECK(SequenceGenerator<int>::ramp(0, 1, 4).repeat(1).ops().size() == 1);
+
+	// a long sequence from a short program
+	SequenceGenerator<int> longGen = SequenceGenerator<int>::ramp(0, 1, 1000).repeat(1000000);
+	CHECK(longGen.length() == 1000000000ull);
+}
+
+void checkFromValues() {
+	// a whole period is sent once with a repeat
+	int periodic[] = { 1, 2, 3, 1, 2, 3, 1, 2, 3 };
+	std::vector<int> pv(periodic, periodic + 9);
+	SequenceGenerator<int> gen = SequenceGenerator<int>::fromValues(pv);
+	CHECK(gen.ops().size() == 2);
+	CHECK(gen.length() == 9);
+	ProtSequence<int, 4> seq;
+	CHECK(play(gen, seq) == pv);
+
+	// runs become ramps
+	int runs[] = { 0, 0, 0, 5, 7, 9, 11, -4 };
+	std::vector<int> rv(runs, runs + 8);
+	gen = SequenceGenerator<int>::fromValues(rv);
+	CHECK(gen.ops().size() == 3);
+	CHECK(gen.length() == 8);
+	CHECK(play(gen, seq) == rv);
+
+	// no structure at all
+	int noise[] = { 3, 1, 4, 1, 5, 9, 2, 6 };
+	std::vector<int> nv(noise, noise + 8);
+	gen = SequenceGenerator<int>::fromValues(nv);
+	CHECK(gen.length() == 8);
+	ProtSequence<int, 8> bigSeq;
+	CHECK(play(gen, bigSeq) == nv);
+
+	std::vector<float> fv;
+	for (int rep = 0; rep < 4; rep++) {
+		for (int k = 0; k < 10; k++) {
+			fv.push_back(0.25f * k);
+		}
+	}
+	SequenceGenerator<float> fgen = SequenceGenerator<float>::fromValues(fv);
+	CHECK(fgen.ops().size() == 2);
+	CHECK(fgen.length() == 40);
+	ProtSequence<float, 4> fseq;
+	CHECK(play(fgen, fseq) == fv);
+
+	CHECK(SequenceGenerator<int>::fromValues(std::vector<int>()).length() == 0);
+}
+
+int main() {
+	checkNestedRepeats();
+	checkGeneratorLength();
+	checkFromValues();
+	return hprottest::testResult("SequenceTests");
+}
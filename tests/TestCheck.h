@@ -0,0 +1,45 @@
+/**
+\file		TestCheck.h
+\brief		Minimal checks shared by the host unit tests
+\date		2017
+\author		Jeffrey R. Kuhn <drjrkuhn@gmail.com>
+\copyright	The University of Texas at Austin
+
+Each test is a small executable. A failed CHECK() prints the expression and
+carries on, and testResult() turns the failures into the exit code ctest
+looks at.
+*/
+
+#pragma once
+
+#include <iostream>
+
+namespace hprottest {
+
+	/** Number of failed checks so far */
+	inline int& failures() {
+		static int count = 0;
+		return count;
+	}
+
+	/** Record the outcome of a single check */
+	inline void check(bool __ok, const char* __expr, const char* __file, int __line) {
+		if (!__ok) {
+			std::cerr << __file << ":" << __line << ": check failed: " << __expr << std::endl;
+			failures()++;
+		}
+	}
+
+	/** Exit code for main(). Prints a summary line. */
+	inline int testResult(const char* __name) {
+		if (failures()) {
+			std::cerr << __name << ": " << failures() << " checks failed" << std::endl;
+			return 1;
+		}
+		std::cout << __name << ": passed" << std::endl;
+		return 0;
+	}
+
+}; // namespace hprottest
+
+#define CHECK(EXPR)		hprottest::check((EXPR), #EXPR, __FILE__, __LINE__)